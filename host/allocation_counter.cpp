@@ -0,0 +1,111 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+#include <new>
+
+namespace host
+{
+	static std::atomic<uint64_t> allocations = 0;
+	static std::atomic<uint64_t> allocated_bytes = 0;
+
+	uint64_t get_allocations()
+	{
+		return allocations.load(std::memory_order_relaxed);
+	}
+
+	uint64_t get_allocated_bytes()
+	{
+		return allocated_bytes.load(std::memory_order_relaxed);
+	}
+
+	static void* allocate(const size_t size, const size_t alignment)
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		void* memory;
+		if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			// aligned_alloc wants the size to be a multiple of the alignment
+			memory = std::aligned_alloc(alignment, (std::max(size, size_t(1)) + alignment - 1) & ~(alignment - 1));
+		}
+		else
+		{
+			memory = std::malloc(std::max(size, size_t(1)));
+		}
+
+		return memory;
+	}
+}
+
+void* operator new(const size_t size)
+{
+	if (auto* memory = host::allocate(size, 0)) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](const size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment)
+{
+	if (auto* memory = host::allocate(size, size_t(alignment))) return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](const size_t size, const std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(const size_t size, const std::nothrow_t&) noexcept
+{
+	return host::allocate(size, 0);
+}
+
+void* operator new[](const size_t size, const std::nothrow_t&) noexcept
+{
+	return host::allocate(size, 0);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	std::free(memory);
+}
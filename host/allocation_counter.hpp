@@ -0,0 +1,9 @@
+#pragma once
+
+namespace host
+{
+	// Every operator new in the process goes through a counting replacement,
+	// unlike the buffer pool's miss counter this sees std::string, std::map and friends too
+	uint64_t get_allocations();
+	uint64_t get_allocated_bytes();
+}
@@ -0,0 +1,223 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+#include "game/demonware/bit_buffer.hpp"
+#include "legacy/bit_buffer.hpp"
+
+#include <random>
+
+using namespace demonware;
+
+// Applies the same randomized operations to the current and the legacy bit_buffer
+// and fails on the first difference, then measures both with a typical message
+struct operation
+{
+	enum type_t
+	{
+		write_bool,
+		write_int32,
+		write_uint32,
+		write_bytes,
+		write_bits,
+		toggle_data_types,
+		count,
+	} type;
+
+	unsigned int bits;
+	std::string data;
+};
+
+static std::vector<operation> generate_sequence(std::mt19937& random)
+{
+	std::vector<operation> sequence(std::uniform_int_distribution<size_t>(1, 32)(random));
+
+	for (auto& operation : sequence)
+	{
+		operation.type = static_cast<operation::type_t>(std::uniform_int_distribution<int>(0, operation::count - 1)(random));
+
+		switch (operation.type)
+		{
+		case operation::write_bytes:
+			operation.bits = std::uniform_int_distribution<unsigned int>(1, 64)(random) * 8;
+			break;
+		case operation::write_bits:
+			operation.bits = std::uniform_int_distribution<unsigned int>(1, 200)(random);
+			break;
+		default:
+			operation.bits = 32;
+			break;
+		}
+
+		operation.data.resize((operation.bits + 7) / 8);
+		for (auto& byte : operation.data)
+		{
+			byte = char(random());
+		}
+	}
+
+	return sequence;
+}
+
+template <typename Buffer>
+static std::string apply_writes(const std::vector<operation>& sequence)
+{
+	Buffer buffer;
+
+	for (const auto& operation : sequence)
+	{
+		unsigned int value{};
+		std::memcpy(&value, operation.data.data(), std::min(sizeof(value), operation.data.size()));
+
+		switch (operation.type)
+		{
+		case operation::write_bool:
+			buffer.write_bool(value & 1);
+			break;
+		case operation::write_int32:
+			buffer.write_int32(int(value));
+			break;
+		case operation::write_uint32:
+			buffer.write_uint32(value);
+			break;
+		case operation::write_bytes:
+			buffer.write_bytes(operation.bits / 8, operation.data.data());
+			break;
+		case operation::write_bits:
+			buffer.write(operation.bits, operation.data.data());
+			break;
+		case operation::toggle_data_types:
+			buffer.set_use_data_types(value & 1);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return buffer.get_buffer();
+}
+
+// Reads back with the same mix of operations, the sequence doesn't have to match what was written
+template <typename Buffer>
+static std::string apply_reads(const std::string& data, const std::vector<operation>& sequence)
+{
+	Buffer buffer(data);
+	std::string results;
+
+	for (const auto& operation : sequence)
+	{
+		std::string output(operation.data.size() + 8, '\0');
+		auto result = true;
+
+		switch (operation.type)
+		{
+		case operation::write_bool:
+			result = buffer.read_bool(reinterpret_cast<bool*>(output.data()));
+			break;
+		case operation::write_int32:
+		case operation::write_uint32:
+			result = buffer.read_uint32(reinterpret_cast<unsigned int*>(output.data()));
+			break;
+		case operation::write_bytes:
+			result = buffer.read_bytes(operation.bits / 8, reinterpret_cast<unsigned char*>(output.data()));
+			break;
+		case operation::write_bits:
+			result = buffer.read(operation.bits, output.data());
+			break;
+		case operation::toggle_data_types:
+			buffer.set_use_data_types(operation.data[0] & 1);
+			break;
+		default:
+			break;
+		}
+
+		// Only the bytes a read is meant to fill are compared
+		output.resize(operation.data.size());
+		results.push_back(result ? '1' : '0');
+		results.append(output);
+	}
+
+	return results;
+}
+
+static bool check_equivalence(const size_t sequences)
+{
+	std::mt19937 random(0x13371337);
+
+	for (size_t i = 0; i < sequences; ++i)
+	{
+		const auto sequence = generate_sequence(random);
+
+		const auto data = apply_writes<bit_buffer>(sequence);
+		if (data != apply_writes<legacy::bit_buffer>(sequence))
+		{
+			fprintf(stderr, "Sequence %zu: written data differs\n", i);
+			return false;
+		}
+
+		// Read back the own data, then data with a differing layout that eventually runs out
+		const auto read_sequence = generate_sequence(random);
+		if (apply_reads<bit_buffer>(data, sequence) != apply_reads<legacy::bit_buffer>(data, sequence)
+			|| apply_reads<bit_buffer>(data, read_sequence) != apply_reads<legacy::bit_buffer>(data, read_sequence))
+		{
+			fprintf(stderr, "Sequence %zu: read data differs\n", i);
+			return false;
+		}
+	}
+
+	fprintf(stderr, "%zu randomized sequences match the legacy bit_buffer\n", sequences);
+	return true;
+}
+
+template <typename Buffer>
+static void measure(const char* name, const size_t iterations)
+{
+	// Shaped like the bdLSGHello and auth handshakes, a mix of flags, ints and ticket blobs
+	char ticket[128]{};
+	uint64_t checksum = 0;
+
+	const auto allocations = host::get_allocations();
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		Buffer writer;
+		writer.write_bool(true);
+		writer.write_uint32(uint32_t(i));
+		writer.write_int32(-1);
+		writer.write_bytes(sizeof(ticket), ticket);
+		writer.write(13, &i);
+		writer.write_bytes(sizeof(ticket), ticket);
+
+		Buffer reader(writer.get_buffer());
+
+		bool flag{};
+		unsigned int value{};
+		unsigned char output[sizeof(ticket)];
+		reader.read_bool(&flag);
+		reader.read_uint32(&value);
+		reader.read_data_type(7);
+		reader.read(32, &value);
+		reader.read_bytes(sizeof(output), output);
+
+		checksum += uint64_t(value) + output[0] + flag;
+	}
+
+	const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+
+	fprintf(stderr, "%-8s %8.1f ns/message %6.2f allocations/message (checksum %llx)\n", name,
+	        time.count() / double(iterations), double(host::get_allocations() - allocations) / double(iterations),
+	        static_cast<unsigned long long>(checksum));
+}
+
+int main(const int argc, char** argv)
+{
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const size_t sequences = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+
+	if (!check_equivalence(sequences)) return 1;
+
+	measure<legacy::bit_buffer>("legacy", iterations);
+	measure<bit_buffer>("current", iterations);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <std_include.hpp>
+
+#include "game/demonware/frame_reassembler.hpp"
+
+using namespace demonware;
+
+static bool failed = false;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failed = true; \
+		} \
+	} while (false)
+
+static std::string make_frame(const std::string& data)
+{
+	const auto size = int32_t(data.size());
+
+	std::string frame(reinterpret_cast<const char*>(&size), sizeof(size));
+	frame.append(data);
+	return frame;
+}
+
+// A frame over the limit has to be skipped as a whole, even when its data arrives in pieces
+static void test_oversized_frame()
+{
+	constexpr int32_t oversized = 0x1000001;
+	constexpr size_t chunk_size = 0x10000;
+
+	frame_reassembler reassembler;
+	frame_reassembler::frame frame{};
+
+	reassembler.append(make_frame("first"));
+	reassembler.append(std::string_view(reinterpret_cast<const char*>(&oversized), sizeof(oversized)));
+
+	CHECK(reassembler.next_frame(&frame));
+	CHECK(frame.type == frame_reassembler::frame_type::message);
+	CHECK(std::string(frame.data, frame.size) == "first");
+
+	// Parsed as headers, the payload would look like more oversized frames
+	std::string payload(oversized, '\x7F');
+	for (size_t offset = 0; offset < payload.size(); offset += chunk_size)
+	{
+		const auto size = std::min(chunk_size, payload.size() - offset);
+		auto chunk = std::string_view(payload).substr(offset, size);
+
+		// The tail of the oversized frame shares its last read with the next frame
+		std::string data(chunk);
+		if (offset + size == payload.size())
+		{
+			data.append(make_frame("second"));
+		}
+
+		reassembler.append(data);
+
+		const auto got_frame = reassembler.next_frame(&frame);
+		CHECK(got_frame == (offset + size == payload.size()));
+	}
+
+	CHECK(frame.type == frame_reassembler::frame_type::message);
+	CHECK(std::string(frame.data, frame.size) == "second");
+	CHECK(!reassembler.next_frame(&frame));
+
+	reassembler.append(make_frame("third"));
+	CHECK(reassembler.next_frame(&frame));
+	CHECK(std::string(frame.data, frame.size) == "third");
+}
+
+int main()
+{
+	// The reassembler logs skipped frames
+	std::freopen("/dev/null", "w", stdout);
+
+	test_oversized_frame();
+
+	fprintf(stderr, failed ? "frame_test failed\n" : "frame_test passed\n");
+	return failed ? 1 : 0;
+}
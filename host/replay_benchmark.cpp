@@ -0,0 +1,142 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+#include "game/demonware/replay.hpp"
+#include "game/demonware/services/bdStorage.hpp"
+#include "game/demonware/services/bdTitleUtilities.hpp"
+
+using namespace demonware;
+
+// Same traffic as -dwbenchmark plus user files, each kind measured on its own
+// so heap allocations can be attributed to it
+struct workload
+{
+	const char* name;
+	std::function<void(replay*)> add;
+};
+
+static void add_user_file(replay* replay, const uint8_t type, const std::string& data)
+{
+	byte_buffer request;
+	request.write_byte(char(type));
+	request.write_string("iw5");
+	request.write_string("mpdata");
+
+	if (type == 10)
+	{
+		request.write_bool(false);
+		request.write_blob(data);
+		request.write_uint64(0x110000100000001);
+	}
+	else
+	{
+		request.write_uint64(0x110000100000001);
+		request.write_string("pc");
+	}
+
+	replay->add_message(10, &request);
+}
+
+static const std::vector<workload> workloads =
+{
+	{
+		"keep-alive", [](replay* replay)
+		{
+			replay->add_keep_alive();
+		}
+	},
+	{
+		"get_server_time", [](replay* replay)
+		{
+			byte_buffer request;
+			request.write_byte(6);
+			replay->add_message(12, &request);
+		}
+	},
+	{
+		"list_publisher_files", [](replay* replay)
+		{
+			byte_buffer request;
+			request.write_byte(6);
+			request.write_uint32(0);
+			request.write_uint16(10);
+			request.write_uint16(0);
+			request.write_string("motd-english.txt");
+			replay->add_message(10, &request);
+		}
+	},
+	{
+		"get_publisher_file", [](replay* replay)
+		{
+			byte_buffer request;
+			request.write_byte(7);
+			request.write_string("online_mp.img");
+			replay->add_message(10, &request);
+		}
+	},
+	{
+		"set_user_file", [](replay* replay)
+		{
+			add_user_file(replay, 10, std::string(0x2000, 'x'));
+		}
+	},
+	{
+		"get_user_file", [](replay* replay)
+		{
+			add_user_file(replay, 12, {});
+		}
+	},
+};
+
+int main(const int argc, char** argv)
+{
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4096;
+
+	// Services log every message they handle, results go to stderr instead
+	std::freopen("/dev/null", "w", stdout);
+
+	service_server server("mw3-pc-lobby.prod.demonware.net");
+	server.register_service<bdStorage>(std::make_unique<memory_backend>());
+	server.register_service<bdTitleUtilities>();
+
+	auto failed = false;
+
+	for (const auto& workload : workloads)
+	{
+		replay replay(&server);
+		workload.add(&replay);
+
+		// Warm up the caches and the buffer pool first
+		replay.run(16);
+
+		const auto allocations = host::get_allocations();
+		const auto allocated_bytes = host::get_allocated_bytes();
+		const auto start = std::chrono::steady_clock::now();
+
+		replay.run(iterations);
+
+		const std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+		const auto messages = double(iterations);
+
+		uint64_t bytes_out = 0;
+		uint64_t pool_misses = 0;
+		for (const auto& entry : replay.get_statistics())
+		{
+			bytes_out += entry.second.bytes_out;
+			pool_misses += entry.second.allocations;
+		}
+
+		fprintf(stderr, "%-22s %10.0f msg/s %8.2f allocations/msg %10.0f bytes/msg %8.2f pool misses/msg\n", workload.name,
+		       messages / std::max(time.count(), 1e-9), double(host::get_allocations() - allocations) / messages,
+		       double(host::get_allocated_bytes() - allocated_bytes) / messages, double(pool_misses) / messages);
+
+		// Everything but keep-alives is answered
+		if (std::string_view(workload.name) != "keep-alive" && !bytes_out)
+		{
+			fprintf(stderr, "%s: no replies\n", workload.name);
+			failed = true;
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+#include "game/demonware/resource_pattern.hpp"
+#include "utils/string.hpp"
+
+#include <random>
+
+using namespace demonware;
+
+// Resolves mutated publisher file names with the std::regex table bdStorage used to have
+// and with resource_pattern, fails if any name maps to a different resource
+struct mapping
+{
+	const char* expression;
+	int id;
+};
+
+// bdStorage's table before resource_pattern
+static const mapping regex_mappings[] =
+{
+	{"heatmap\\.raw", DW_HEATMAP},
+	{"motd-.*\\.txt", DW_MOTD},
+	{"online_mp\\.img", DW_IMG},
+	{"online_[Tt][Uu][0-9]+_mp_.+\\.wad", DW_WAD},
+	{"playlists(_.+)?\\.aggr", DW_PLAYLIST},
+	{"social_[Tt][Uu][0-9]+\\.cfg", DW_CONFIG},
+	{"iotd-.*\\.txt", DW_IOTD_TXT},
+	{"iotd-.*\\.jpg", DW_IOTD_IMG},
+};
+
+// As mapped in bdStorage's constructor, groups are split into separate patterns
+static const mapping pattern_mappings[] =
+{
+	{"heatmap\\.raw", DW_HEATMAP},
+	{"motd-.*\\.txt", DW_MOTD},
+	{"online_mp\\.img", DW_IMG},
+	{"online_[Tt][Uu][0-9]+_mp_.+\\.wad", DW_WAD},
+	{"playlists\\.aggr", DW_PLAYLIST},
+	{"playlists_.+\\.aggr", DW_PLAYLIST},
+	{"social_[Tt][Uu][0-9]+\\.cfg", DW_CONFIG},
+	{"iotd-.*\\.txt", DW_IOTD_TXT},
+	{"iotd-.*\\.jpg", DW_IOTD_IMG},
+};
+
+static const char* seed_names[] =
+{
+	"heatmap.raw",
+	"motd-english.txt",
+	"online_mp.img",
+	"online_tu14_mp_1.wad",
+	"online_TU3_mp_english.wad",
+	"playlists.aggr",
+	"playlists_tu14.aggr",
+	"social_tu14.cfg",
+	"iotd-english.txt",
+	"iotd-english.jpg",
+};
+
+static std::vector<std::string> generate_names(const size_t count)
+{
+	// Characters the patterns care about, plus line breaks and bytes outside of ASCII
+	static const std::string alphabet = "abcdefghijklmnopqrstuvwxyzTU0123456789_-.\\[]*+?\r\n\x80\xff";
+
+	std::mt19937 random(0x13371337);
+	std::vector<std::string> names;
+	names.reserve(count);
+
+	const auto pick = [&](const size_t size)
+	{
+		return std::uniform_int_distribution<size_t>(0, size - 1)(random);
+	};
+
+	while (names.size() < count)
+	{
+		std::string name = seed_names[pick(ARRAYSIZE(seed_names))];
+
+		const auto mutations = pick(4);
+		for (size_t i = 0; i < mutations; ++i)
+		{
+			const auto position = pick(name.size() + 1);
+			const auto chr = alphabet[pick(alphabet.size())];
+
+			switch (pick(3))
+			{
+			case 0:
+				name.insert(name.begin() + position, chr);
+				break;
+			case 1:
+				if (position < name.size()) name.erase(position, 1);
+				break;
+			default:
+				if (position < name.size()) name[position] = chr;
+				break;
+			}
+		}
+
+		names.push_back(std::move(name));
+	}
+
+	return names;
+}
+
+static std::string escape(const std::string& name)
+{
+	std::string result;
+	for (const auto chr : name)
+	{
+		if (chr >= 0x20 && chr < 0x7F) result.push_back(chr);
+		else result.append(utils::string::va("\\x%02X", uint8_t(chr)));
+	}
+
+	return result;
+}
+
+template <typename Matcher>
+static std::vector<std::pair<Matcher, int>> compile(const mapping* mappings, const size_t count)
+{
+	std::vector<std::pair<Matcher, int>> result;
+	for (size_t i = 0; i < count; ++i)
+	{
+		result.emplace_back(Matcher{mappings[i].expression}, mappings[i].id);
+	}
+
+	return result;
+}
+
+static int find_regex(const std::vector<std::pair<std::regex, int>>& table, const std::string& name)
+{
+	for (const auto& entry : table)
+	{
+		if (std::regex_match(name, entry.first)) return entry.second;
+	}
+
+	return 0;
+}
+
+static int find_pattern(const std::vector<std::pair<resource_pattern, int>>& table, const std::string& name)
+{
+	for (const auto& entry : table)
+	{
+		if (entry.first.match(name)) return entry.second;
+	}
+
+	return 0;
+}
+
+template <typename Function>
+static void measure(const char* name, const std::vector<std::string>& names, const Function& function)
+{
+	size_t matches = 0;
+
+	const auto allocations = host::get_allocations();
+	const auto start = std::chrono::steady_clock::now();
+
+	for (const auto& entry : names)
+	{
+		matches += function(entry) != 0;
+	}
+
+	const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+
+	fprintf(stderr, "%-16s %8.1f ns/name %6.2f allocations/name (%zu matches)\n", name,
+	        time.count() / double(names.size()), double(host::get_allocations() - allocations) / double(names.size()),
+	        matches);
+}
+
+int main(const int argc, char** argv)
+{
+	const size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+	const auto regex_table = compile<std::regex>(regex_mappings, ARRAYSIZE(regex_mappings));
+	const auto pattern_table = compile<resource_pattern>(pattern_mappings, ARRAYSIZE(pattern_mappings));
+	const auto names = generate_names(count);
+
+	size_t matches = 0;
+	size_t differences = 0;
+
+	for (const auto& name : names)
+	{
+		const auto expected = find_regex(regex_table, name);
+		const auto result = find_pattern(pattern_table, name);
+
+		matches += expected != 0;
+
+		if (expected != result && differences++ < 16)
+		{
+			fprintf(stderr, "%s: std::regex maps to %d, resource_pattern to %d\n", escape(name).data(), expected,
+			        result);
+		}
+	}
+
+	fprintf(stderr, "%zu names, %zu matching a resource, %zu differences\n", names.size(), matches, differences);
+	if (differences) return 1;
+
+	measure("std::regex", names, [&](const std::string& name)
+	{
+		return find_regex(regex_table, name);
+	});
+
+	measure("resource_pattern", names, [&](const std::string& name)
+	{
+		return find_pattern(pattern_table, name);
+	});
+
+	return 0;
+}
@@ -0,0 +1,115 @@
+#include <std_include.hpp>
+#include "allocation_counter.hpp"
+
+#include "game/demonware/handler_metrics.hpp"
+#include "game/demonware/service_server.hpp"
+#include "game/demonware/services/bdStorage.hpp"
+#include "game/demonware/services/bdTitleUtilities.hpp"
+
+using namespace demonware;
+
+// Client side latency with the server's worker running, the way the game's socket hooks see it:
+// send() queues the request, wait_for_reply() blocks until the worker answered, recv() drains the reply
+static bool round_trip(service_server* server, const std::string& request, std::string* buffer)
+{
+	server->send(request.data(), int(request.size()));
+
+	size_t received = 0;
+	size_t expected = sizeof(int32_t);
+
+	while (received < expected)
+	{
+		const auto length = server->recv(buffer->data() + received, int(buffer->size() - received));
+		if (length <= 0)
+		{
+			if (!server->wait_for_reply(std::chrono::seconds(1))) return false;
+			continue;
+		}
+
+		received += length;
+
+		// Replies are framed by their size
+		if (expected == sizeof(int32_t) && received >= sizeof(int32_t))
+		{
+			int32_t size{};
+			std::memcpy(&size, buffer->data(), sizeof(size));
+			expected += size_t(size);
+
+			if (buffer->size() < expected) buffer->resize(expected);
+		}
+	}
+
+	return true;
+}
+
+static std::string frame_message(const uint8_t service, byte_buffer* data)
+{
+	byte_buffer buffer;
+	buffer.set_use_data_types(false);
+	buffer.write_int32(static_cast<int>(data->get_buffer().size()) + 2);
+	buffer.write_bool(false);
+	buffer.write_byte(service);
+	buffer.write(data->get_buffer());
+
+	return buffer.get_buffer();
+}
+
+static bool measure(service_server* server, const char* name, const std::string& request, const size_t iterations)
+{
+	std::string buffer(0x4000, '\0');
+	handler_metrics metrics;
+
+	// Warm up the worker, the caches and the buffer pool first
+	for (size_t i = 0; i < 64; ++i)
+	{
+		if (!round_trip(server, request, &buffer)) return false;
+	}
+
+	const auto allocations = host::get_allocations();
+
+	for (size_t i = 0; i < iterations; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		if (!round_trip(server, request, &buffer))
+		{
+			fprintf(stderr, "%s: no reply\n", name);
+			return false;
+		}
+
+		metrics.record(std::chrono::steady_clock::now() - start);
+	}
+
+	const auto summary = metrics.get_summary();
+	fprintf(stderr, "%-20s mean %.1f us, p50 %llu us, p90 %llu us, p99 %llu us, max %llu us, %.2f allocations\n", name,
+	        summary.mean, static_cast<unsigned long long>(summary.p50), static_cast<unsigned long long>(summary.p90),
+	        static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.max),
+	        double(host::get_allocations() - allocations) / double(iterations));
+
+	return true;
+}
+
+int main(const int argc, char** argv)
+{
+	const size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+
+	// Services log every message they handle, results go to stderr instead
+	std::freopen("/dev/null", "w", stdout);
+
+	service_server server("mw3-pc-lobby.prod.demonware.net");
+	server.register_service<bdStorage>(std::make_unique<memory_backend>());
+	server.register_service<bdTitleUtilities>();
+	server.start();
+
+	byte_buffer time_request;
+	time_request.write_byte(6);
+
+	byte_buffer file_request;
+	file_request.write_byte(7);
+	file_request.write_string("online_mp.img");
+
+	const auto succeeded = measure(&server, "get_server_time", frame_message(12, &time_request), iterations)
+		&& measure(&server, "get_publisher_file", frame_message(10, &file_request), iterations);
+
+	server.stop();
+	return succeeded ? 0 : 1;
+}
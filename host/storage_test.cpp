@@ -0,0 +1,311 @@
+#include <std_include.hpp>
+
+#include "game/demonware/data_types.hpp"
+#include "game/demonware/services/bdStorage.hpp"
+
+using namespace demonware;
+
+// Calls bdStorage's handlers directly and checks what they answer.
+// Replies are collected in plain form, the way a client sees them after decryption.
+class test_server final : public i_server
+{
+public:
+	int send(const char* /*buf*/, int /*len*/) override
+	{
+		return 0;
+	}
+
+	int recv(char* /*buf*/, int /*len*/) override
+	{
+		return 0;
+	}
+
+	void send_reply(reply* data) override
+	{
+		std::string plain_data;
+		data->get_plain_data(&plain_data);
+		this->replies.push_back(std::move(plain_data));
+	}
+
+	std::vector<std::string> replies;
+};
+
+// Lets a second bdStorage see what the first one stored, like a restart of the game
+class shared_backend final : public storage_backend
+{
+public:
+	explicit shared_backend(std::shared_ptr<storage_backend> backend) : backend_(std::move(backend))
+	{
+	}
+
+	bool read(const std::string& name, std::string* data, uint32_t* modified_time) override
+	{
+		return this->backend_->read(name, data, modified_time);
+	}
+
+	bool write(const std::string& name, const std::string& data) override
+	{
+		return this->backend_->write(name, data);
+	}
+
+	std::vector<std::string> list() override
+	{
+		return this->backend_->list();
+	}
+
+	bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) override
+	{
+		return this->backend_->stat(name, size, modified_time);
+	}
+
+	bool read_header(const std::string& name, const size_t size, std::string* data) override
+	{
+		return this->backend_->read_header(name, size, data);
+	}
+
+private:
+	std::shared_ptr<storage_backend> backend_;
+};
+
+// Fails a number of writes, like a full disk that's cleaned up eventually
+class failing_backend final : public storage_backend
+{
+public:
+	explicit failing_backend(const size_t failures) : failures_(failures)
+	{
+	}
+
+	bool read(const std::string& name, std::string* data, uint32_t* modified_time) override
+	{
+		return this->backend_.read(name, data, modified_time);
+	}
+
+	bool write(const std::string& name, const std::string& data) override
+	{
+		if (this->failures_ > 0)
+		{
+			--this->failures_;
+			return false;
+		}
+
+		return this->backend_.write(name, data);
+	}
+
+	std::vector<std::string> list() override
+	{
+		return this->backend_.list();
+	}
+
+	bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) override
+	{
+		return this->backend_.stat(name, size, modified_time);
+	}
+
+	bool read_header(const std::string& name, const size_t size, std::string* data) override
+	{
+		return this->backend_.read_header(name, size, data);
+	}
+
+	size_t get_failures() const
+	{
+		return this->failures_;
+	}
+
+private:
+	std::atomic<size_t> failures_;
+	memory_backend backend_;
+};
+
+struct parsed_reply
+{
+	uint32_t error;
+	uint32_t count;
+	byte_buffer objects;
+};
+
+static bool failed = false;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition); \
+			failed = true; \
+		} \
+	} while (false)
+
+static parsed_reply call(bdStorage* storage, test_server* server, byte_buffer* request)
+{
+	server->replies.clear();
+	storage->call_service(server, request->get_buffer());
+
+	parsed_reply result{};
+	if (server->replies.size() != 1) return {0xFFFFFFFF};
+
+	result.objects = byte_buffer(server->replies.front());
+
+	uint64_t transaction_id;
+	uint8_t type;
+	result.objects.read_uint64(&transaction_id);
+	result.objects.read_uint32(&result.error);
+	result.objects.read_byte(&type);
+
+	if (!result.error)
+	{
+		result.objects.read_uint32(&result.count);
+		if (result.count) result.objects.read_uint32(&result.count);
+	}
+
+	return result;
+}
+
+static parsed_reply set_user_files(bdStorage* storage, test_server* server,
+                                   const std::vector<std::pair<std::string, std::string>>& files)
+{
+	byte_buffer request;
+	request.write_byte(14);
+	request.write_string("iw5");
+	request.write_uint64(0x110000100000001);
+	request.write_bool(false);
+
+	for (const auto& file : files)
+	{
+		request.write_string(file.first);
+		request.write_blob(file.second);
+	}
+
+	return call(storage, server, &request);
+}
+
+static parsed_reply get_user_files(bdStorage* storage, test_server* server, const std::vector<std::string>& names)
+{
+	byte_buffer request;
+	request.write_byte(13);
+	request.write_string("iw5");
+	request.write_uint64(0x110000100000001);
+	request.write_string("pc");
+
+	for (const auto& name : names)
+	{
+		request.write_string(name);
+	}
+
+	return call(storage, server, &request);
+}
+
+static void test_batched_files()
+{
+	test_server server;
+	bdStorage storage(std::make_unique<memory_backend>());
+
+	auto reply = set_user_files(&storage, &server, {{"mpdata", std::string(0x100, 'a')}, {"mpstats", "stats"}});
+	CHECK(reply.error == 0);
+	CHECK(reply.count == 2);
+
+	bdFileInfo info{};
+	CHECK(bdFileInfo::fields::deserialize(info, &reply.objects));
+	CHECK(info.filename == "mpdata");
+	CHECK(info.file_size == 0x100);
+
+	// One reply for all of them, missing files are left out
+	reply = get_user_files(&storage, &server, {"mpdata", "missing", "mpstats"});
+	CHECK(reply.error == 0);
+	CHECK(reply.count == 2);
+
+	bdNamedFileData file{};
+	CHECK(bdNamedFileData::fields::deserialize(file, &reply.objects));
+	CHECK(file.filename == "mpdata");
+	CHECK(file.file_data == std::string(0x100, 'a'));
+
+	CHECK(bdNamedFileData::fields::deserialize(file, &reply.objects));
+	CHECK(file.filename == "mpstats");
+	CHECK(file.file_data == "stats");
+
+	reply = get_user_files(&storage, &server, {});
+	CHECK(reply.error == 0);
+	CHECK(reply.count == 0);
+}
+
+static void test_reserved_names()
+{
+	test_server server;
+	const auto backend = std::make_shared<memory_backend>();
+	auto storage = std::make_unique<bdStorage>(std::make_unique<shared_backend>(backend));
+
+	// Nothing from a rejected batch is stored
+	auto reply = set_user_files(storage.get(), &server, {{"mpdata", "data"}, {".legacy_filenames", "index"}});
+	CHECK(reply.error == game::native::BD_PERMISSION_DENIED);
+
+	reply = get_user_files(storage.get(), &server, {"mpdata"});
+	CHECK(reply.error == 0);
+	CHECK(reply.count == 0);
+
+	reply = get_user_files(storage.get(), &server, {".legacy_filenames"});
+	CHECK(reply.error == game::native::BD_PERMISSION_DENIED);
+
+	// The legacy index isn't affected by a client file of its former name
+	byte_buffer legacy_request;
+	legacy_request.write_byte(1);
+	legacy_request.write_string("profile");
+	legacy_request.write_bool(false);
+	legacy_request.write_blob("legacy");
+	CHECK(call(storage.get(), &server, &legacy_request).error == 0);
+
+	reply = set_user_files(storage.get(), &server, {{"legacy_filenames", "client data"}});
+	CHECK(reply.error == 0);
+
+	// Queued writes are flushed when the old instance goes away
+	storage = std::make_unique<bdStorage>(std::make_unique<shared_backend>(backend));
+
+	byte_buffer list_request;
+	list_request.write_byte(5);
+	list_request.write_uint64(0);
+	list_request.write_uint32(0);
+	list_request.write_uint16(10);
+	list_request.write_uint16(0);
+	list_request.write_string("");
+
+	reply = call(storage.get(), &server, &list_request);
+	CHECK(reply.error == 0);
+	CHECK(reply.count == 1);
+
+	bdFileInfo info{};
+	CHECK(bdFileInfo::fields::deserialize(info, &reply.objects));
+	CHECK(info.filename == "profile");
+	CHECK(info.file_id == user_storage::get_file_id("profile"));
+}
+
+static void test_failed_writes()
+{
+	auto backend = std::make_unique<failing_backend>(2);
+	auto* failing = backend.get();
+
+	user_storage storage(std::move(backend));
+	storage.write("mpdata", "new");
+
+	// Retried until it's stored, reads get the pending data meanwhile
+	const auto data = storage.read("mpdata");
+	CHECK(data && *data == "new");
+
+	storage.flush();
+	CHECK(failing->get_failures() == 0);
+
+	std::string stored;
+	uint32_t modified_time;
+	CHECK(failing->read("mpdata", &stored, &modified_time));
+	CHECK(stored == "new");
+}
+
+int main()
+{
+	// Services log every message they handle
+	std::freopen("/dev/null", "w", stdout);
+
+	test_batched_files();
+	test_reserved_names();
+	test_failed_writes();
+
+	fprintf(stderr, failed ? "storage_test failed\n" : "storage_test passed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// The few game types the DW services reference
+namespace game
+{
+	namespace native
+	{
+		enum bdLobbyErrorCode : uint32_t
+		{
+			BD_NO_ERROR = 0x0,
+			BD_NO_FILE = 0x3E8,
+			BD_PERMISSION_DENIED = 0x3E9,
+			BD_EXTERNAL_STORAGE_SERVICE_ERROR = 0x3EC,
+		};
+
+		enum bdNATType : uint8_t
+		{
+			BD_NAT_UNKNOWN = 0x0,
+			BD_NAT_OPEN = 0x1,
+			BD_NAT_MODERATE = 0x2,
+			BD_NAT_STRICT = 0x3,
+		};
+	}
+}
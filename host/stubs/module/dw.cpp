@@ -0,0 +1,25 @@
+#include <std_include.hpp>
+#include "dw.hpp"
+
+namespace demonware
+{
+	std::string dw::get_key(const bool /*encrypt*/)
+	{
+		return std::string(24, '\0');
+	}
+
+	std::shared_ptr<const utils::cryptography::des3::context> dw::get_cipher(const bool encrypt)
+	{
+		static const auto encryption_cipher = std::make_shared<const utils::cryptography::des3::context>(get_key(true));
+		static const auto decryption_cipher = std::make_shared<const utils::cryptography::des3::context>(get_key(false));
+
+		return encrypt ? encryption_cipher : decryption_cipher;
+	}
+
+	std::string dw::get_iv(const uint32_t seed)
+	{
+		std::string iv(8, '\0');
+		std::memcpy(iv.data(), &seed, sizeof(seed));
+		return iv;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <utils/cryptography.hpp>
+
+#include "game/demonware/service_server.hpp"
+
+namespace demonware
+{
+	// What service_server needs from the module, without sockets or hooks
+	class dw final
+	{
+	public:
+		static std::string get_key(bool encrypt);
+		static std::shared_ptr<const utils::cryptography::des3::context> get_cipher(bool encrypt);
+		static std::string get_iv(uint32_t seed);
+	};
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Stands in for src/std_include.hpp when building the DW code on a non-Windows host.
+// Only the standard library is available, Windows and game types the code needs come from stubs.
+
+#include <map>
+#include <list>
+#include <set>
+#include <deque>
+#include <atomic>
+#include <array>
+#include <bit>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <queue>
+#include <regex>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <utility>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <cassert>
+#include <algorithm>
+
+#include <sys/socket.h>
+
+#define ARRAYSIZE(x) (sizeof(x) / sizeof((x)[0]))
+#define SOCKET_ERROR (-1)
+#define __int16 short
+
+// Has to be the type behind (u)int64_t, the code passes uint64_t pointers as unsigned __int64*
+#define __int64 long
+static_assert(sizeof(long) == 8, "Hosts have to be LP64");
+
+using BYTE = unsigned char;
+using INT = int;
+using LPSTR = char*;
+
+// Truncates like the MSVC version with _TRUNCATE, instead of invoking the invalid parameter handler
+inline int strcpy_s(char* destination, const size_t size, const char* source)
+{
+	if (!size) return -1;
+
+	const auto length = std::min(std::strlen(source), size - 1);
+	std::memcpy(destination, source, length);
+	destination[length] = '\0';
+
+	return 0;
+}
+
+#include "resource.hpp"
@@ -0,0 +1,35 @@
+#include <std_include.hpp>
+#include "compression.hpp"
+
+namespace utils::compression
+{
+	zstd::dictionary::dictionary(const std::string& /*data*/, int /*level*/)
+	{
+	}
+
+	bool zstd::dictionary::is_valid() const
+	{
+		return false;
+	}
+
+	uint32_t zstd::dictionary::get_id() const
+	{
+		return 0;
+	}
+
+	std::string zstd::compress(std::string_view /*data*/, int /*level*/, const dictionary* /*dict*/)
+	{
+		return {};
+	}
+
+	bool zstd::decompress(std::string_view /*data*/, size_t /*size*/, std::string* /*output*/,
+	                      const dictionary* /*dict*/)
+	{
+		return false;
+	}
+
+	std::string zstd::train_dictionary(const std::vector<std::string>& /*samples*/, size_t /*capacity*/)
+	{
+		return {};
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// zstd isn't available on the host: nothing compresses, files are stored as they are
+namespace utils::compression
+{
+	class zstd final
+	{
+	public:
+		class dictionary final
+		{
+		public:
+			dictionary(const std::string& data, int level);
+
+			bool is_valid() const;
+			uint32_t get_id() const;
+		};
+
+		static std::string compress(std::string_view data, int level, const dictionary* dict);
+		static bool decompress(std::string_view data, size_t size, std::string* output, const dictionary* dict);
+
+		static std::string train_dictionary(const std::vector<std::string>& samples, size_t capacity);
+	};
+};
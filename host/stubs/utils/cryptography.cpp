@@ -0,0 +1,86 @@
+#include <std_include.hpp>
+#include "cryptography.hpp"
+
+namespace utils::cryptography
+{
+	des3::context::context(const std::string& key) : valid_(key.size() == 24)
+	{
+	}
+
+	bool des3::context::is_valid() const
+	{
+		return this->valid_;
+	}
+
+	std::string des3::context::encrypt(const std::string_view data, std::string_view /*iv*/) const
+	{
+		return std::string(data);
+	}
+
+	std::string des3::context::decrypt(const std::string_view data, std::string_view /*iv*/) const
+	{
+		return std::string(data);
+	}
+
+	void des3::context::encrypt(char* /*data*/, size_t /*length*/, std::string_view /*iv*/) const
+	{
+	}
+
+	void des3::context::decrypt(char* /*data*/, size_t /*length*/, std::string_view /*iv*/) const
+	{
+	}
+
+	std::string sha1::compute(const std::string& data, const bool hex)
+	{
+		return compute(reinterpret_cast<const uint8_t*>(data.data()), data.size(), hex);
+	}
+
+	std::string sha1::compute(const uint8_t* data, const size_t length, const bool hex)
+	{
+		// 64 bit FNV-1a, spread over the 20 bytes of a real digest
+		uint64_t hash = 0xcbf29ce484222325;
+		for (size_t i = 0; i < length; ++i)
+		{
+			hash = (hash ^ data[i]) * 0x100000001b3;
+		}
+
+		std::string result(20, '\0');
+		for (size_t i = 0; i < result.size(); i += sizeof(hash))
+		{
+			std::memcpy(result.data() + i, &hash, std::min(sizeof(hash), result.size() - i));
+			hash = (hash ^ i) * 0x100000001b3;
+		}
+
+		if (!hex) return result;
+
+		std::string hex_result;
+		for (const auto byte : result)
+		{
+			char buffer[3];
+			snprintf(buffer, sizeof(buffer), "%02x", uint8_t(byte));
+			hex_result.append(buffer);
+		}
+
+		return hex_result;
+	}
+
+	unsigned int jenkins_one_at_a_time::compute(const std::string& data)
+	{
+		return compute(data.data(), data.size());
+	}
+
+	unsigned int jenkins_one_at_a_time::compute(const char* key, const size_t len)
+	{
+		unsigned int hash, i;
+		for (hash = i = 0; i < len; ++i)
+		{
+			hash += key[i];
+			hash += (hash << 10);
+			hash ^= (hash >> 6);
+		}
+		hash += (hash << 3);
+		hash ^= (hash >> 11);
+		hash += (hash << 15);
+		return hash;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+// Same interface as src/utils/cryptography.hpp, without libtomcrypt.
+// Hashes keep their sizes, but none of this is cryptographically sound.
+namespace utils::cryptography
+{
+	class des3 final
+	{
+	public:
+		// Leaves data as is, benchmarks only send plain messages
+		class context final
+		{
+		public:
+			context() = default;
+			explicit context(const std::string& key);
+
+			bool is_valid() const;
+
+			std::string encrypt(std::string_view data, std::string_view iv) const;
+			std::string decrypt(std::string_view data, std::string_view iv) const;
+
+			void encrypt(char* data, size_t length, std::string_view iv) const;
+			void decrypt(char* data, size_t length, std::string_view iv) const;
+
+		private:
+			bool valid_ = false;
+		};
+	};
+
+	class sha1 final
+	{
+	public:
+		static std::string compute(const std::string& data, bool hex = false);
+		static std::string compute(const uint8_t* data, size_t length, bool hex = false);
+	};
+
+	class jenkins_one_at_a_time final
+	{
+	public:
+		static unsigned int compute(const std::string& data);
+		static unsigned int compute(const char* key, size_t len);
+	};
+}
@@ -0,0 +1,35 @@
+#include <std_include.hpp>
+#include "flags.hpp"
+#include "string.hpp"
+
+namespace utils::flags
+{
+	static std::vector<std::string> parse_flags()
+	{
+		std::vector<std::string> flags;
+
+		const auto* environment = std::getenv("DW_FLAGS");
+		if (!environment) return flags;
+
+		std::string_view remaining = environment;
+		while (!remaining.empty())
+		{
+			const auto end = std::min(remaining.find(' '), remaining.size());
+			const auto flag = remaining.substr(0, end);
+			remaining.remove_prefix(std::min(end + 1, remaining.size()));
+
+			if (flag.size() > 1 && flag[0] == '-')
+			{
+				flags.emplace_back(string::to_lower(std::string(flag.substr(1))));
+			}
+		}
+
+		return flags;
+	}
+
+	bool has_flag(const std::string& flag)
+	{
+		static const auto enabled_flags = parse_flags();
+		return std::find(enabled_flags.begin(), enabled_flags.end(), string::to_lower(flag)) != enabled_flags.end();
+	}
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace utils::flags
+{
+	// Taken from the DW_FLAGS environment variable, e.g. DW_FLAGS="-compressuserfiles"
+	bool has_flag(const std::string& flag);
+}
@@ -0,0 +1,43 @@
+#include <std_include.hpp>
+#include "nt.hpp"
+
+#include <utils/io.hpp>
+
+namespace utils::nt
+{
+	mapped_file::mapped_file(const std::string& path) : data_(std::make_unique<std::string>())
+	{
+		this->valid_ = io::read_file(path, this->data_.get());
+	}
+
+	bool mapped_file::is_valid() const
+	{
+		return this->valid_;
+	}
+
+	std::string_view mapped_file::get_data() const
+	{
+		if (!this->valid_) return {};
+		return *this->data_;
+	}
+
+	std::string_view get_resource(const int id)
+	{
+		static std::mutex mutex;
+		static std::map<int, std::string> resources;
+
+		std::lock_guard _(mutex);
+
+		auto& resource = resources[id];
+		if (resource.empty())
+		{
+			resource.resize(0x1000 + size_t(id % 16) * 0x100);
+			for (size_t i = 0; i < resource.size(); ++i)
+			{
+				resource[i] = char('a' + (i + size_t(id)) % 26);
+			}
+		}
+
+		return resource;
+	}
+}
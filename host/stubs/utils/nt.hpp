@@ -0,0 +1,29 @@
+#pragma once
+
+// Resource and file mapping replacements, the host has no module resources to map
+namespace utils::nt
+{
+	// Reads the whole file instead of mapping it
+	class mapped_file final
+	{
+	public:
+		mapped_file() = default;
+		explicit mapped_file(const std::string& path);
+
+		mapped_file(mapped_file&& obj) noexcept = default;
+		mapped_file& operator=(mapped_file&& obj) noexcept = default;
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool is_valid() const;
+		std::string_view get_data() const;
+
+	private:
+		bool valid_ = false;
+		std::unique_ptr<std::string> data_;
+	};
+
+	// Deterministic filler of a few KiB per resource id, valid for the whole run
+	std::string_view get_resource(int id);
+}
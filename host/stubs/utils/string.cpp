@@ -0,0 +1,30 @@
+#include <std_include.hpp>
+#include "string.hpp"
+
+namespace utils::string
+{
+	const char* va(const char* fmt, ...)
+	{
+		static thread_local char buffers[8][0x400];
+		static thread_local size_t current_buffer = 0;
+
+		auto* buffer = buffers[current_buffer++ % ARRAYSIZE(buffers)];
+
+		va_list ap;
+		va_start(ap, fmt);
+		vsnprintf(buffer, sizeof(buffers[0]), fmt, ap);
+		va_end(ap);
+
+		return buffer;
+	}
+
+	std::string to_lower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](const unsigned char input)
+		{
+			return static_cast<char>(std::tolower(input));
+		});
+
+		return text;
+	}
+}
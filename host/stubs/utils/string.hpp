@@ -0,0 +1,8 @@
+#pragma once
+
+namespace utils::string
+{
+	const char* va(const char* fmt, ...);
+
+	std::string to_lower(std::string text);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <pthread.h>
+
+namespace utils::thread
+{
+	template <typename ...Args>
+	std::thread create_named_thread(const std::string& name, Args&&... args)
+	{
+		auto t = std::thread(std::forward<Args>(args)...);
+
+		// Linux limits names to 15 characters
+		pthread_setname_np(t.native_handle(), name.substr(0, 15).data());
+		return t;
+	}
+}
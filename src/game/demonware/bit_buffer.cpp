@@ -91,74 +91,96 @@ namespace demonware
 		return this->write(5, &data);
 	}
 
+	// Bits are processed in chunks of up to 56, so a chunk shifted by
+	// its offset into the first byte always fits a 64 bit accumulator
+	static constexpr auto max_chunk_bits = 56u;
+
+	static uint64_t chunk_mask(const unsigned int bits)
+	{
+		return ~0ull >> (64 - bits);
+	}
+
 	bool bit_buffer::read(unsigned int bits, void* output)
 	{
 		if (bits == 0) return false;
 		if ((this->current_bit_ + bits) > (this->buffer_.size() * 8)) return false;
 
-		int cur_byte = this->current_bit_ >> 3;
-		auto cur_out = 0;
+		const auto* bytes = reinterpret_cast<const uint8_t*>(this->buffer_.data());
+		auto* output_bytes = static_cast<uint8_t*>(output);
 
-		const char* bytes = this->buffer_.data();
-		const auto output_bytes = reinterpret_cast<unsigned char*>(output);
+		if ((this->current_bit_ & 7) == 0 && bits >= 8)
+		{
+			const auto whole_bytes = bits >> 3;
+			std::memcpy(output_bytes, bytes + (this->current_bit_ >> 3), whole_bytes);
+
+			output_bytes += whole_bytes;
+			this->current_bit_ += whole_bytes * 8;
+			bits &= 7;
+		}
 
 		while (bits > 0)
 		{
-			const int min_bit = (bits < 8) ? bits : 8;
-			const auto this_byte = bytes[cur_byte++] & 0xFF;
-			const int remain = this->current_bit_ & 7;
-
-			if ((min_bit + remain) <= 8)
-			{
-				output_bytes[cur_out] = BYTE((0xFF >> (8 - min_bit)) & (this_byte >> remain));
-			}
-			else
-			{
-				output_bytes[cur_out] = BYTE(
-					(0xFF >> (8 - min_bit)) & (bytes[cur_byte] << (8 - remain)) | (this_byte >> remain));
-			}
-
-			cur_out++;
-			this->current_bit_ += min_bit;
-			bits -= min_bit;
+			const auto chunk = std::min(bits, max_chunk_bits);
+			const auto bit_pos = this->current_bit_ & 7;
+			const auto span = (bit_pos + chunk + 7) >> 3;
+
+			uint64_t value = 0;
+			std::memcpy(&value, bytes + (this->current_bit_ >> 3), span);
+			value = (value >> bit_pos) & chunk_mask(chunk);
+
+			std::memcpy(output_bytes, &value, (chunk + 7) >> 3);
+
+			output_bytes += chunk >> 3;
+			this->current_bit_ += chunk;
+			bits -= chunk;
 		}
 
 		return true;
 	}
 
-	bool bit_buffer::write(const unsigned int bits, const void* data)
+	bool bit_buffer::write(unsigned int bits, const void* data)
 	{
 		if (bits == 0) return false;
-		this->buffer_.resize(this->buffer_.size() + (bits >> 3) + 1);
-
-		int bit = bits;
-		const auto bytes = const_cast<char*>(this->buffer_.data());
-		const auto* input_bytes = reinterpret_cast<const unsigned char*>(data);
 
-		while (bit > 0)
+		const size_t required_size = (this->current_bit_ + bits + 7) >> 3;
+		if (this->buffer_.size() < required_size)
 		{
-			const int bit_pos = this->current_bit_ & 7;
-			auto rem_bit = 8 - bit_pos;
-			const auto this_write = (bit < rem_bit) ? bit : rem_bit;
+			this->buffer_.resize(required_size);
+		}
+
+		auto* bytes = reinterpret_cast<uint8_t*>(this->buffer_.data());
+		const auto* input_bytes = static_cast<const uint8_t*>(data);
 
-			const BYTE mask = ((0xFF >> rem_bit) | (0xFF << (bit_pos + this_write)));
-			const int byte_pos = this->current_bit_ >> 3;
+		if ((this->current_bit_ & 7) == 0 && bits >= 8)
+		{
+			const auto whole_bytes = bits >> 3;
+			std::memcpy(bytes + (this->current_bit_ >> 3), input_bytes, whole_bytes);
 
-			const BYTE temp_byte = (mask & bytes[byte_pos]);
-			const BYTE this_bit = ((bits - bit) & 7);
-			const auto this_byte = (bits - bit) >> 3;
+			input_bytes += whole_bytes;
+			this->current_bit_ += whole_bytes * 8;
+			bits &= 7;
+		}
 
-			auto this_data = input_bytes[this_byte];
+		while (bits > 0)
+		{
+			const auto chunk = std::min(bits, max_chunk_bits);
+			const auto bit_pos = this->current_bit_ & 7;
+			const auto span = (bit_pos + chunk + 7) >> 3;
+			auto* target = bytes + (this->current_bit_ >> 3);
 
-			const auto next_byte = (((bits - 1) >> 3) > this_byte) ? input_bytes[this_byte + 1] : 0;
+			uint64_t value = 0;
+			std::memcpy(&value, input_bytes, (chunk + 7) >> 3);
 
-			this_data = BYTE((next_byte << (8 - this_bit)) | (this_data >> this_bit));
+			uint64_t current = 0;
+			std::memcpy(&current, target, span);
 
-			const BYTE out_byte = (~mask & (this_data << bit_pos) | temp_byte);
-			bytes[byte_pos] = out_byte;
+			const auto mask = chunk_mask(chunk) << bit_pos;
+			current = (current & ~mask) | ((value << bit_pos) & mask);
+			std::memcpy(target, &current, span);
 
-			this->current_bit_ += this_write;
-			bit -= this_write;
+			input_bytes += chunk >> 3;
+			this->current_bit_ += chunk;
+			bits -= chunk;
 		}
 
 		return true;
@@ -230,12 +230,16 @@ namespace demonware
 
 	bool byte_buffer::write_blob(const char* data, const int length)
 	{
-		this->write_data_type(0x13);
-		this->write_uint32(length);
-
+		this->write_blob_header(length);
 		return this->write(length, data);
 	}
 
+	bool byte_buffer::write_blob_header(const int length)
+	{
+		this->write_data_type(0x13);
+		return this->write_uint32(length);
+	}
+
 	bool byte_buffer::write_array_header(const unsigned char type, const unsigned int element_count,
 	                                     const unsigned int element_size)
 	{
@@ -271,9 +275,9 @@ namespace demonware
 		return true;
 	}
 
-	bool byte_buffer::write(const std::string& data)
+	bool byte_buffer::write(const std::string_view data)
 	{
-		return this->write(data.size(), data.data());
+		return this->write(static_cast<int>(data.size()), data.data());
 	}
 
 	void byte_buffer::set_use_data_types(const bool use_data_types)
@@ -286,6 +290,12 @@ namespace demonware
 		return this->buffer_.size();
 	}
 
+	void byte_buffer::clear()
+	{
+		this->buffer_.clear();
+		this->current_byte_ = 0;
+	}
+
 	bool byte_buffer::is_using_data_types() const
 	{
 		return use_data_types_;
@@ -44,16 +44,20 @@ namespace demonware
 		bool write_string(const std::string& data);
 		bool write_blob(const char* data, int length);
 		bool write_blob(const std::string& data);
+		bool write_blob_header(int length);
 
 		bool write_array_header(unsigned char type, unsigned int element_count, unsigned int element_size);
 
 		bool read(int bytes, void* output);
 		bool write(int bytes, const void* data);
-		bool write(const std::string& data);
+		bool write(std::string_view data);
 
 		void set_use_data_types(bool use_data_types);
 		size_t size() const;
 
+		// Empties the buffer but keeps its allocation
+		void clear();
+
 		bool is_using_data_types() const;
 
 		std::string& get_buffer();
@@ -0,0 +1,160 @@
+#include <std_include.hpp>
+#include "byte_buffer_view.hpp"
+
+namespace demonware
+{
+	bool byte_buffer_view::read_byte(unsigned char* output)
+	{
+		if (!this->read_data_type(3)) return false;
+		return this->read(1, output);
+	}
+
+	bool byte_buffer_view::read_bool(bool* output)
+	{
+		if (!this->read_data_type(1)) return false;
+		return this->read(1, output);
+	}
+
+	bool byte_buffer_view::read_int16(short* output)
+	{
+		if (!this->read_data_type(5)) return false;
+		return this->read(2, output);
+	}
+
+	bool byte_buffer_view::read_uint16(unsigned short* output)
+	{
+		if (!this->read_data_type(6)) return false;
+		return this->read(2, output);
+	}
+
+	bool byte_buffer_view::read_int32(int* output)
+	{
+		if (!this->read_data_type(7)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_buffer_view::read_uint32(unsigned int* output)
+	{
+		if (!this->read_data_type(8)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_buffer_view::read_int64(__int64* output)
+	{
+		if (!this->read_data_type(9)) return false;
+		return this->read(8, output);
+	}
+
+	bool byte_buffer_view::read_uint64(unsigned __int64* output)
+	{
+		if (!this->read_data_type(10)) return false;
+		return this->read(8, output);
+	}
+
+	bool byte_buffer_view::read_float(float* output)
+	{
+		if (!this->read_data_type(13)) return false;
+		return this->read(4, output);
+	}
+
+	bool byte_buffer_view::read_string(std::string* output)
+	{
+		std::string_view view;
+		if (!this->read_string(&view)) return false;
+
+		output->assign(view);
+		return true;
+	}
+
+	bool byte_buffer_view::read_string(std::string_view* output)
+	{
+		if (!this->read_data_type(16)) return false;
+
+		const auto remaining = this->get_remaining();
+		const auto end = remaining.find('\0');
+		if (end == std::string_view::npos) return false;
+
+		*output = remaining.substr(0, end);
+		this->current_byte_ += end + 1;
+
+		return true;
+	}
+
+	bool byte_buffer_view::read_blob(std::string* output)
+	{
+		std::string_view view;
+		if (!this->read_blob(&view)) return false;
+
+		output->assign(view);
+		return true;
+	}
+
+	bool byte_buffer_view::read_blob(std::string_view* output)
+	{
+		if (!this->read_data_type(0x13)) return false;
+
+		unsigned int size;
+		if (!this->read_uint32(&size)) return false;
+
+		return this->read_view(size, output);
+	}
+
+	bool byte_buffer_view::read_data_type(const char expected)
+	{
+		if (!this->use_data_types_) return true;
+
+		char type;
+		if (!this->read(1, &type)) return false;
+		return type == expected;
+	}
+
+	bool byte_buffer_view::read(const size_t bytes, void* output)
+	{
+		if (bytes > this->buffer_.size() - this->current_byte_) return false;
+
+		std::memcpy(output, this->buffer_.data() + this->current_byte_, bytes);
+		this->current_byte_ += bytes;
+
+		return true;
+	}
+
+	bool byte_buffer_view::read_view(const size_t bytes, std::string_view* output)
+	{
+		if (bytes > this->buffer_.size() - this->current_byte_) return false;
+
+		*output = this->buffer_.substr(this->current_byte_, bytes);
+		this->current_byte_ += bytes;
+
+		return true;
+	}
+
+	void byte_buffer_view::set_use_data_types(const bool use_data_types)
+	{
+		this->use_data_types_ = use_data_types;
+	}
+
+	size_t byte_buffer_view::size() const
+	{
+		return this->buffer_.size();
+	}
+
+	bool byte_buffer_view::is_using_data_types() const
+	{
+		return this->use_data_types_;
+	}
+
+	std::string_view byte_buffer_view::get_buffer() const
+	{
+		return this->buffer_;
+	}
+
+	std::string_view byte_buffer_view::get_remaining() const
+	{
+		return this->buffer_.substr(this->current_byte_);
+	}
+
+	bool byte_buffer_view::has_more_data() const
+	{
+		return this->buffer_.size() > this->current_byte_;
+	}
+}
@@ -0,0 +1,81 @@
+#include <std_include.hpp>
+#include "capture.hpp"
+
+#include <utils/io.hpp>
+
+namespace demonware
+{
+	capture::capture(const std::string& path) : start_(std::chrono::steady_clock::now())
+	{
+		const auto parent = std::filesystem::path(path).parent_path();
+		if (!parent.empty()) utils::io::create_directory(parent.generic_string());
+
+		this->stream_.open(path, std::ios::binary | std::ios::trunc);
+		if (!this->stream_.is_open())
+		{
+			printf("DW: Failed to open capture file %s\n", path.data());
+			return;
+		}
+
+		this->stream_.write(reinterpret_cast<const char*>(&file_magic), sizeof(file_magic));
+	}
+
+	bool capture::is_open() const
+	{
+		return this->stream_.is_open();
+	}
+
+	void capture::write(const direction_type direction, const unsigned long server, const uint8_t service,
+	                    const std::string_view data)
+	{
+		record_header header{};
+		header.server = uint32_t(server);
+		header.size = uint32_t(data.size());
+		header.direction = uint8_t(direction);
+		header.service = service;
+
+		std::lock_guard _(this->mutex_);
+		if (!this->stream_.is_open()) return;
+
+		header.time = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - this->start_).count());
+
+		this->stream_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		this->stream_.write(data.data(), std::streamsize(data.size()));
+	}
+
+	bool capture::load(const std::string& path, std::vector<record>* records)
+	{
+		std::string data;
+		if (!utils::io::read_file(path, &data)) return false;
+
+		uint32_t magic{};
+		if (data.size() < sizeof(magic)) return false;
+
+		std::memcpy(&magic, data.data(), sizeof(magic));
+		if (magic != file_magic) return false;
+
+		// A capture cut off by a crash still replays up to its last complete record
+		size_t offset = sizeof(magic);
+		while (data.size() - offset >= sizeof(record_header))
+		{
+			record_header header{};
+			std::memcpy(&header, data.data() + offset, sizeof(header));
+			offset += sizeof(header);
+
+			if (data.size() - offset < header.size) break;
+
+			record record{};
+			record.time = header.time;
+			record.server = header.server;
+			record.direction = static_cast<direction_type>(header.direction);
+			record.service = header.service;
+			record.data.assign(data.data() + offset, header.size);
+
+			records->push_back(std::move(record));
+			offset += header.size;
+		}
+
+		return true;
+	}
+}
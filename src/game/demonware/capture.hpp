@@ -0,0 +1,52 @@
+#pragma once
+
+namespace demonware
+{
+	// Records decrypted traffic of the service servers, so a session can be replayed offline.
+	// Servers write from their own workers, records are appended in the order they come in.
+	class capture final
+	{
+	public:
+		enum class direction_type : uint8_t
+		{
+			incoming,
+			outgoing,
+		};
+
+		struct record
+		{
+			// Microseconds since the capture was started
+			uint64_t time;
+			unsigned long server;
+			direction_type direction;
+
+			// Control frames are recorded as service 0 with their raw frame as data
+			uint8_t service;
+			std::string data;
+		};
+
+		explicit capture(const std::string& path);
+
+		bool is_open() const;
+		void write(direction_type direction, unsigned long server, uint8_t service, std::string_view data);
+
+		static bool load(const std::string& path, std::vector<record>* records);
+
+	private:
+		static constexpr uint32_t file_magic = 0x31435744; // DWC1
+
+		struct record_header
+		{
+			uint64_t time;
+			uint32_t server;
+			uint32_t size;
+			uint8_t direction;
+			uint8_t service;
+			uint16_t reserved;
+		};
+
+		std::mutex mutex_;
+		std::ofstream stream_;
+		std::chrono::steady_clock::time_point start_;
+	};
+}
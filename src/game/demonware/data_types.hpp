@@ -1,30 +1,37 @@
 #pragma once
 #include "i_server.hpp"
+#include "serializer.hpp"
 #include "game/structs.hpp"
 
 namespace demonware
 {
-	class bdFileData final : public i_serializable
+	class bdFileData final : public serializable<bdFileData>
 	{
 	public:
 		std::string file_data;
 
+		bdFileData() = default;
+
 		explicit bdFileData(std::string buffer) : file_data(std::move(buffer))
 		{
 		}
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_blob(this->file_data);
-		}
+		using fields = field_list<
+			blob_field<&bdFileData::file_data>>;
+	};
 
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_blob(&this->file_data);
-		}
+	class bdNamedFileData final : public serializable<bdNamedFileData>
+	{
+	public:
+		std::string filename;
+		std::string file_data;
+
+		using fields = field_list<
+			field<&bdNamedFileData::filename>,
+			blob_field<&bdNamedFileData::file_data>>;
 	};
 
-	class bdFileInfo final : public i_serializable
+	class bdFileInfo final : public serializable<bdFileInfo>
 	{
 	public:
 		uint64_t file_id;
@@ -35,30 +42,17 @@ namespace demonware
 		std::string filename;
 		uint32_t file_size;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->file_size);
-			buffer->write_uint64(this->file_id);
-			buffer->write_uint32(this->create_time);
-			buffer->write_uint32(this->modified_time);
-			buffer->write_bool(this->priv);
-			buffer->write_uint64(this->owner_id);
-			buffer->write_string(this->filename);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->file_size);
-			buffer->read_uint64(&this->file_id);
-			buffer->read_uint32(&this->create_time);
-			buffer->read_uint32(&this->modified_time);
-			buffer->read_bool(&this->priv);
-			buffer->read_uint64(&this->owner_id);
-			buffer->read_string(&this->filename);
-		}
+		using fields = field_list<
+			field<&bdFileInfo::file_size>,
+			field<&bdFileInfo::file_id>,
+			field<&bdFileInfo::create_time>,
+			field<&bdFileInfo::modified_time>,
+			field<&bdFileInfo::priv>,
+			field<&bdFileInfo::owner_id>,
+			field<&bdFileInfo::filename>>;
 	};
 
-	class bdGroupCount final : public i_serializable
+	class bdGroupCount final : public serializable<bdGroupCount>
 	{
 	public:
 		uint32_t group_id;
@@ -70,36 +64,21 @@ namespace demonware
 			this->group_count = 0;
 		}
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->group_id);
-			buffer->write_uint32(this->group_count);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->group_id);
-			buffer->read_uint32(&this->group_count);
-		}
+		using fields = field_list<
+			field<&bdGroupCount::group_id>,
+			field<&bdGroupCount::group_count>>;
 	};
 
-	class bdTimeStamp final : public i_serializable
+	class bdTimeStamp final : public serializable<bdTimeStamp>
 	{
 	public:
 		uint32_t unix_time;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint32(this->unix_time);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint32(&this->unix_time);
-		}
+		using fields = field_list<
+			field<&bdTimeStamp::unix_time>>;
 	};
 
-	class bdDMLInfo : public i_serializable
+	class bdDMLInfo : public serializable<bdDMLInfo>
 	{
 	public:
 		std::string country_code; // Char [3]
@@ -109,48 +88,24 @@ namespace demonware
 		float latitude;
 		float longitude;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_string(this->country_code);
-			buffer->write_string(this->country);
-			buffer->write_string(this->region);
-			buffer->write_string(this->city);
-			buffer->write_float(this->latitude);
-			buffer->write_float(this->longitude);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_string(&this->country_code);
-			buffer->read_string(&this->country);
-			buffer->read_string(&this->region);
-			buffer->read_string(&this->city);
-			buffer->read_float(&this->latitude);
-			buffer->read_float(&this->longitude);
-		}
+		using fields = field_list<
+			field<&bdDMLInfo::country_code>,
+			field<&bdDMLInfo::country>,
+			field<&bdDMLInfo::region>,
+			field<&bdDMLInfo::city>,
+			field<&bdDMLInfo::latitude>,
+			field<&bdDMLInfo::longitude>>;
 	};
 
-	class bdDMLRawData final : public bdDMLInfo
+	class bdDMLRawData final : public serializable<bdDMLRawData, bdDMLInfo>
 	{
 	public:
 		uint32_t asn; // Autonomous System Number.
 		std::string timezone;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			bdDMLInfo::serialize(buffer);
-
-			buffer->write_uint32(this->asn);
-			buffer->write_string(this->timezone);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			bdDMLInfo::deserialize(buffer);
-
-			buffer->read_uint32(&this->asn);
-			buffer->read_string(&this->timezone);
-		}
+		using fields = bdDMLInfo::fields::append<
+			field<&bdDMLRawData::asn>,
+			field<&bdDMLRawData::timezone>>;
 	};
 
 	class bdSessionID final : public i_serializable
@@ -274,23 +229,15 @@ namespace demonware
 		}
 	};
 
-	class bdPerformanceValue final : public i_serializable
+	class bdPerformanceValue final : public serializable<bdPerformanceValue>
 	{
 	public:
 		uint64_t user_id;
 		int64_t performance;
 
-		void serialize(byte_buffer* buffer) override
-		{
-			buffer->write_uint64(this->user_id);
-			buffer->write_int64(this->performance);
-		}
-
-		void deserialize(byte_buffer* buffer) override
-		{
-			buffer->read_uint64(&this->user_id);
-			buffer->read_int64(&this->performance);
-		}
+		using fields = field_list<
+			field<&bdPerformanceValue::user_id>,
+			field<&bdPerformanceValue::performance>>;
 	};
 
 	struct bdSockAddr final
@@ -0,0 +1,105 @@
+#include <std_include.hpp>
+#include "frame_reassembler.hpp"
+
+namespace demonware
+{
+	void frame_reassembler::append(std::string_view data)
+	{
+		if (data.empty()) return;
+
+		if (!this->total_bytes_.load(std::memory_order_relaxed))
+		{
+			this->start_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+		}
+
+		this->total_bytes_.fetch_add(data.size(), std::memory_order_release);
+
+		// The rest of an oversized frame never enters the buffer
+		if (this->skip_)
+		{
+			const auto skipped = std::min(this->skip_, data.size());
+			this->skip_ -= skipped;
+			data.remove_prefix(skipped);
+
+			if (data.empty()) return;
+		}
+
+		// Drop consumed frames before growing the buffer
+		if (this->offset_)
+		{
+			this->buffer_.erase(0, this->offset_);
+			this->offset_ = 0;
+		}
+
+		this->buffer_.append(data);
+	}
+
+	bool frame_reassembler::next_frame(frame* output)
+	{
+		const auto available = this->buffer_.size() - this->offset_;
+		if (available < sizeof(int32_t)) return false;
+
+		int32_t size;
+		std::memcpy(&size, this->buffer_.data() + this->offset_, sizeof(size));
+
+		// Control frames are just their 4 byte header, anything after it is the next frame
+		if (size <= 0 || size == 200)
+		{
+			output->type = size <= 0 ? frame_type::keep_alive : frame_type::connection_id;
+			output->data = nullptr;
+			output->size = 0;
+
+			this->offset_ += sizeof(int32_t);
+			return true;
+		}
+
+		// Skipped as a whole, so its data isn't mistaken for the following frames
+		if (size_t(size) > max_frame_size)
+		{
+			printf("DW: Skipping frame of %d bytes\n", size);
+
+			this->skip(sizeof(int32_t) + size_t(size));
+			return this->next_frame(output);
+		}
+
+		if (available - sizeof(int32_t) < size_t(size)) return false;
+
+		output->type = frame_type::message;
+		output->data = this->buffer_.data() + this->offset_ + sizeof(int32_t);
+		output->size = size_t(size);
+
+		this->offset_ += sizeof(int32_t) + size_t(size);
+		this->total_frames_.fetch_add(1, std::memory_order_relaxed);
+
+		return true;
+	}
+
+	frame_reassembler::statistics frame_reassembler::get_statistics() const
+	{
+		statistics result{};
+		result.bytes = this->total_bytes_.load(std::memory_order_acquire);
+		result.frames = this->total_frames_.load(std::memory_order_relaxed);
+
+		if (result.bytes)
+		{
+			const std::chrono::steady_clock::time_point start(
+				std::chrono::steady_clock::duration(this->start_.load(std::memory_order_relaxed)));
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() > 0)
+			{
+				result.bytes_per_second = double(result.bytes) / elapsed.count();
+				result.frames_per_second = double(result.frames) / elapsed.count();
+			}
+		}
+
+		return result;
+	}
+
+	void frame_reassembler::skip(const size_t size)
+	{
+		// Frames handed out before stay valid until the next append
+		const auto buffered = std::min(size, this->buffer_.size() - this->offset_);
+		this->offset_ += buffered;
+		this->skip_ = size - buffered;
+	}
+}
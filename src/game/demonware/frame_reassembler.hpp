@@ -0,0 +1,55 @@
+#pragma once
+
+namespace demonware
+{
+	// Splits the client's TCP stream into length-prefixed frames.
+	// Incomplete frames are kept until the rest of their data arrives.
+	class frame_reassembler final
+	{
+	public:
+		enum class frame_type
+		{
+			message,
+			keep_alive,
+			connection_id,
+		};
+
+		struct frame
+		{
+			frame_type type;
+
+			// Points into the reassembler, valid until the next append
+			char* data;
+			size_t size;
+		};
+
+		struct statistics
+		{
+			uint64_t bytes;
+			uint64_t frames;
+			double bytes_per_second;
+			double frames_per_second;
+		};
+
+		void append(std::string_view data);
+		bool next_frame(frame* output);
+
+		statistics get_statistics() const;
+
+	private:
+		static constexpr size_t max_frame_size = 0x1000000;
+
+		std::string buffer_;
+		size_t offset_ = 0;
+
+		// Bytes of an oversized frame that haven't arrived yet
+		size_t skip_ = 0;
+
+		// Statistics may be read from outside the server thread
+		std::atomic<uint64_t> total_bytes_ = 0;
+		std::atomic<uint64_t> total_frames_ = 0;
+		std::atomic<std::chrono::steady_clock::rep> start_ = 0;
+
+		void skip(size_t size);
+	};
+}
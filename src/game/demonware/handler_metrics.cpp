@@ -0,0 +1,83 @@
+#include <std_include.hpp>
+#include "handler_metrics.hpp"
+
+namespace demonware
+{
+	void handler_metrics::record(const std::chrono::nanoseconds duration)
+	{
+		const auto value = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+
+		this->calls_.fetch_add(1, std::memory_order_relaxed);
+		this->total_.fetch_add(value, std::memory_order_relaxed);
+		this->buckets_[get_bucket(value)].fetch_add(1, std::memory_order_relaxed);
+
+		auto max = this->max_.load(std::memory_order_relaxed);
+		while (value > max && !this->max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	handler_metrics::summary handler_metrics::get_summary() const
+	{
+		summary result{};
+
+		// Buckets are summed up, so a call in progress can make them differ from the count
+		std::array<uint64_t, bucket_count> buckets{};
+		uint64_t calls = 0;
+
+		for (size_t i = 0; i < bucket_count; ++i)
+		{
+			buckets[i] = this->buckets_[i].load(std::memory_order_relaxed);
+			calls += buckets[i];
+		}
+
+		result.calls = this->calls_.load(std::memory_order_relaxed);
+		result.max = this->max_.load(std::memory_order_relaxed);
+		if (!calls || !result.calls) return result;
+
+		result.mean = double(this->total_.load(std::memory_order_relaxed)) / double(result.calls);
+
+		const auto percentile = [&](const uint64_t percent)
+		{
+			const auto target = std::max(uint64_t(1), (calls * percent + 99) / 100);
+
+			uint64_t count = 0;
+			for (size_t i = 0; i < bucket_count; ++i)
+			{
+				count += buckets[i];
+				if (count >= target) return std::min(get_bucket_value(i), result.max);
+			}
+
+			return result.max;
+		};
+
+		result.p50 = percentile(50);
+		result.p90 = percentile(90);
+		result.p99 = percentile(99);
+
+		return result;
+	}
+
+	size_t handler_metrics::get_bucket(uint64_t value)
+	{
+		value = std::min(value, uint64_t(UINT32_MAX));
+		if (value < sub_buckets) return size_t(value);
+
+		// The top two bits below the highest set one pick the sub bucket
+		const auto exponent = size_t(std::bit_width(value) - 1);
+		const auto sub_bucket = size_t(value >> (exponent - 2)) & (sub_buckets - 1);
+
+		return (exponent - 1) * sub_buckets + sub_bucket;
+	}
+
+	uint64_t handler_metrics::get_bucket_value(const size_t bucket)
+	{
+		if (bucket < sub_buckets) return bucket;
+
+		// Highest value that still falls into the bucket
+		const auto exponent = bucket / sub_buckets + 1;
+		const auto lower = uint64_t(sub_buckets + bucket % sub_buckets) << (exponent - 2);
+
+		return lower + (uint64_t(1) << (exponent - 2)) - 1;
+	}
+}
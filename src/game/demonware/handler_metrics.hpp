@@ -0,0 +1,38 @@
+#pragma once
+
+namespace demonware
+{
+	// Call count and latency histogram of a single handler.
+	// Recorded by the server's worker and read from the console, so everything is atomic.
+	class handler_metrics final
+	{
+	public:
+		struct summary
+		{
+			uint64_t calls;
+			double mean;
+			uint64_t p50;
+			uint64_t p90;
+			uint64_t p99;
+			uint64_t max;
+		};
+
+		void record(std::chrono::nanoseconds duration);
+
+		// Latencies are in microseconds, percentiles are accurate to a quarter of their magnitude
+		summary get_summary() const;
+
+	private:
+		// Log-linear buckets like HDR histograms: 4 per power of two up to 2^32 us
+		static constexpr size_t sub_buckets = 4;
+		static constexpr size_t bucket_count = 32 * sub_buckets;
+
+		std::atomic<uint64_t> calls_ = 0;
+		std::atomic<uint64_t> total_ = 0;
+		std::atomic<uint64_t> max_ = 0;
+		std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+
+		static size_t get_bucket(uint64_t value);
+		static uint64_t get_bucket_value(size_t bucket);
+	};
+}
@@ -1,14 +1,32 @@
 #pragma once
 #include "bit_buffer.hpp"
 #include "byte_buffer.hpp"
+#include "byte_buffer_view.hpp"
 
 namespace demonware
 {
+	// Produces a reply piece by piece while the client reads it
+	class reply_stream
+	{
+	public:
+		virtual ~reply_stream() = default;
+
+		// Appends the next chunk, returns false once everything was read
+		virtual bool read(std::string* output) = 0;
+	};
+
 	class reply
 	{
 	public:
 		virtual ~reply() = default;
-		virtual std::string get_data() = 0;
+		virtual void get_data(std::string* output) = 0;
+
+		// Replies too large to be built at once stream their data instead
+		virtual std::unique_ptr<reply_stream> get_stream() { return {}; }
+
+		// What the client sees once the reply is decrypted, without the framing
+		virtual void get_plain_data(std::string* output) { this->get_data(output); }
+		virtual uint8_t get_type() const { return 0; }
 	};
 
 	class raw_reply : public reply
@@ -16,28 +34,49 @@ namespace demonware
 	public:
 		raw_reply() = default;
 
-		explicit raw_reply(std::string data) : buffer_(std::move(data))
+		explicit raw_reply(const std::string_view data) : buffer_(data)
 		{
 		}
 
-		virtual std::string get_data() override
+		virtual void get_data(std::string* output) override
 		{
-			return this->buffer_;
+			output->append(this->buffer_);
 		}
 
 	protected:
-		std::string buffer_;
+		// Replies only live for the duration of send_reply,
+		// so they reference the payload instead of copying it
+		std::string_view buffer_;
 	};
 
 	class typed_reply : public raw_reply
 	{
 	public:
-		typed_reply(uint8_t _type) : type_(_type)
+		typed_reply(uint8_t _type, const std::string_view header, const std::string_view data)
+			: raw_reply(data), header_(header), type_(_type)
+		{
+		}
+
+		// Appended after the data, the owner keeps it alive if the reply is streamed
+		void set_tail(const std::string_view tail, std::shared_ptr<const void> owner)
 		{
+			this->tail_ = tail;
+			this->tail_owner_ = std::move(owner);
 		}
 
+		void get_plain_data(std::string* output) override
+		{
+			output->append(this->header_);
+			output->append(this->buffer_);
+			output->append(this->tail_);
+		}
+
+		uint8_t get_type() const override { return this->type_; }
+
 	protected:
-		uint8_t get_type() const { return this->type_; }
+		std::string_view header_;
+		std::string_view tail_;
+		std::shared_ptr<const void> tail_owner_;
 
 	private:
 		uint8_t type_;
@@ -46,33 +85,87 @@ namespace demonware
 	class encrypted_reply final : public typed_reply
 	{
 	public:
-		encrypted_reply(const uint8_t type, bit_buffer* bbuffer) : typed_reply(type)
+		encrypted_reply(const uint8_t type, const std::string_view header, const std::string_view data)
+			: typed_reply(type, header, data)
 		{
-			this->buffer_.append(bbuffer->get_buffer());
 		}
 
-		encrypted_reply(const uint8_t type, byte_buffer* bbuffer) : typed_reply(type)
+		encrypted_reply(const uint8_t type, bit_buffer* bbuffer) : typed_reply(type, {}, bbuffer->get_buffer())
 		{
-			this->buffer_.append(bbuffer->get_buffer());
 		}
 
-		virtual std::string get_data() override;
+		encrypted_reply(const uint8_t type, byte_buffer* bbuffer) : typed_reply(type, {}, bbuffer->get_buffer())
+		{
+		}
+
+		virtual void get_data(std::string* output) override;
+		virtual std::unique_ptr<reply_stream> get_stream() override;
 	};
 
 	class unencrypted_reply final : public typed_reply
 	{
 	public:
-		unencrypted_reply(uint8_t _type, bit_buffer* bbuffer) : typed_reply(_type)
+		unencrypted_reply(const uint8_t _type, const std::string_view header, const std::string_view data)
+			: typed_reply(_type, header, data)
+		{
+		}
+
+		unencrypted_reply(uint8_t _type, bit_buffer* bbuffer) : typed_reply(_type, {}, bbuffer->get_buffer())
 		{
-			this->buffer_.append(bbuffer->get_buffer());
 		}
 
-		unencrypted_reply(uint8_t _type, byte_buffer* bbuffer) : typed_reply(_type)
+		unencrypted_reply(uint8_t _type, byte_buffer* bbuffer) : typed_reply(_type, {}, bbuffer->get_buffer())
 		{
-			this->buffer_.append(bbuffer->get_buffer());
 		}
 
-		virtual std::string get_data() override;
+		virtual void get_data(std::string* output) override;
+	};
+
+	// Recycles reply storage, so once a server has warmed up
+	// building and queueing a reply doesn't hit the heap anymore
+	class buffer_pool final
+	{
+	public:
+		std::string acquire()
+		{
+			std::lock_guard _(this->mutex_);
+			if (this->buffers_.empty())
+			{
+				++this->misses_;
+				return {};
+			}
+
+			auto buffer = std::move(this->buffers_.back());
+			this->buffers_.pop_back();
+			return buffer;
+		}
+
+		void release(std::string&& buffer)
+		{
+			// Don't keep large file transfers alive
+			if (buffer.capacity() == 0 || buffer.capacity() > max_capacity) return;
+			buffer.clear();
+
+			std::lock_guard _(this->mutex_);
+			if (this->buffers_.size() < max_buffers)
+			{
+				this->buffers_.push_back(std::move(buffer));
+			}
+		}
+
+		// Acquires that couldn't be served from the pool and had to allocate
+		uint64_t get_misses() const
+		{
+			return this->misses_.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static constexpr size_t max_buffers = 16;
+		static constexpr size_t max_capacity = 0x10000;
+
+		std::mutex mutex_;
+		std::vector<std::string> buffers_;
+		std::atomic<uint64_t> misses_ = 0;
 	};
 
 	class remote_reply;
@@ -87,18 +180,13 @@ namespace demonware
 
 		virtual void send_reply(reply* reply) = 0;
 
-		virtual std::shared_ptr<remote_reply> create_message(uint8_t type)
-		{
-			auto reply = std::make_shared<remote_reply>(this, type);
-			return reply;
-		}
+		virtual remote_reply create_message(uint8_t type);
+		virtual service_reply create_reply(uint8_t type, uint32_t error = 0 /*Game::bdLobbyErrorCode::BD_NO_ERROR*/);
 
-		virtual std::shared_ptr<service_reply> create_reply(uint8_t type,
-		                                                    uint32_t error = 0 /*Game::bdLobbyErrorCode::BD_NO_ERROR*/)
-		{
-			auto reply = std::make_shared<service_reply>(this, type, error);
-			return reply;
-		}
+		buffer_pool& get_buffer_pool() { return this->buffer_pool_; }
+
+	private:
+		buffer_pool buffer_pool_;
 	};
 
 	class remote_reply final
@@ -111,11 +199,24 @@ namespace demonware
 		template <typename BufferType>
 		void send(BufferType* buffer, const bool encrypted)
 		{
-			std::unique_ptr<typed_reply> reply;
+			this->send({}, buffer->get_buffer(), encrypted);
+		}
 
-			if (encrypted) reply = std::make_unique<encrypted_reply>(this->type_, buffer);
-			else reply = std::make_unique<unencrypted_reply>(this->type_, buffer);
-			this->server_->send_reply(reply.get());
+		void send(const std::string_view header, const std::string_view data, const bool encrypted,
+		          const std::string_view tail = {}, std::shared_ptr<const void> tail_owner = {})
+		{
+			if (encrypted)
+			{
+				encrypted_reply reply(this->type_, header, data);
+				reply.set_tail(tail, std::move(tail_owner));
+				this->server_->send_reply(&reply);
+			}
+			else
+			{
+				unencrypted_reply reply(this->type_, header, data);
+				reply.set_tail(tail, std::move(tail_owner));
+				this->server_->send_reply(&reply);
+			}
 		}
 
 		uint8_t get_type() const { return this->type_; }
@@ -143,59 +244,110 @@ namespace demonware
 	{
 	public:
 		service_reply(i_server* _server, uint8_t _type, uint32_t _error) : type_(_type), error_(_error),
-		                                                                   reply_(_server, 1)
+		                                                                   server_(_server), reply_(_server, 1),
+		                                                                   objects_(_server->get_buffer_pool().acquire())
 		{
 		}
 
+		~service_reply()
+		{
+			this->server_->get_buffer_pool().release(std::move(this->objects_.get_buffer()));
+		}
+
+		service_reply(service_reply&&) = default;
+		service_reply(const service_reply&) = delete;
+		service_reply& operator=(const service_reply&) = delete;
+
 		uint64_t send()
 		{
-			static uint64_t id = 0x8000000000000001;
+			// Servers reply from their own workers
+			static std::atomic<uint64_t> id = 0x8000000000000001;
 			const auto transaction_id = ++id;
 
-			byte_buffer buffer;
-			buffer.write_uint64(transaction_id);
-			buffer.write_uint32(this->error_);
-			buffer.write_byte(this->type_);
+			auto& pool = this->server_->get_buffer_pool();
+
+			byte_buffer header(pool.acquire());
+			header.write_uint64(transaction_id);
+			header.write_uint32(this->error_);
+			header.write_byte(this->type_);
+
+			std::string_view objects, file;
 
 			if (!this->error_)
 			{
-				buffer.write_uint32(uint32_t(this->objects_.size()));
-				if (!this->objects_.empty())
+				header.write_uint32(this->object_count_);
+				if (this->object_count_)
 				{
-					buffer.write_uint32(uint32_t(this->objects_.size()));
-
-					for (auto& object : this->objects_)
-					{
-						object->serialize(&buffer);
-					}
-
-					this->objects_.clear();
+					header.write_uint32(this->object_count_);
+					objects = this->objects_.get_buffer();
+					file = this->file_;
 				}
 			}
 			else
 			{
-				buffer.write_uint64(transaction_id);
+				header.write_uint64(transaction_id);
 			}
 
-			this->reply_.send(&buffer, true);
+			this->reply_.send(header.get_buffer(), objects, true, file, std::move(this->file_owner_));
+
+			pool.release(std::move(header.get_buffer()));
+			this->objects_.clear();
+			this->object_count_ = 0;
+			this->file_ = {};
+
 			return transaction_id;
 		}
 
-		void add(const std::shared_ptr<i_serializable>& object)
+		// Objects are serialized right away, they don't need to outlive the call
+		template <typename T>
+		void add(T& object)
 		{
-			this->objects_.push_back(object);
+			static_assert(std::is_base_of_v<i_serializable, T>, "Reply objects must inherit from i_serializable");
+
+			if constexpr (requires { typename T::fields; })
+			{
+				T::fields::serialize(object, &this->objects_);
+			}
+			else
+			{
+				object.serialize(&this->objects_);
+			}
+
+			++this->object_count_;
 		}
 
-		void add(i_serializable* object)
+		// Adds a file as a blob object without copying it.
+		// It has to be the last object, large files are streamed to the client
+		// and the owner keeps the data alive until that's done.
+		void add_file(const std::string_view data, std::shared_ptr<const void> owner = {})
 		{
-			this->add(std::shared_ptr<i_serializable>(object));
+			this->objects_.write_blob_header(static_cast<int>(data.size()));
+			this->file_ = data;
+			this->file_owner_ = std::move(owner);
+
+			++this->object_count_;
 		}
 
 	private:
 		uint8_t type_;
 		uint32_t error_;
+		i_server* server_;
 		remote_reply reply_;
 
-		std::vector<std::shared_ptr<i_serializable>> objects_;
+		byte_buffer objects_;
+		uint32_t object_count_ = 0;
+
+		std::string_view file_;
+		std::shared_ptr<const void> file_owner_;
 	};
+
+	inline remote_reply i_server::create_message(const uint8_t type)
+	{
+		return remote_reply(this, type);
+	}
+
+	inline service_reply i_server::create_reply(const uint8_t type, const uint32_t error)
+	{
+		return service_reply(this, type, error);
+	}
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "i_server.hpp"
+#include "handler_metrics.hpp"
 
 namespace demonware
 {
@@ -7,33 +8,35 @@ namespace demonware
 	{
 	public:
 		virtual ~i_service() = default;
-		i_service() = default;
+
+		i_service()
+		{
+			// Services handling messages on their own are accounted as subservice 0
+			this->metrics_[0] = std::make_unique<handler_metrics>();
+		}
 
 		// Copying or moving a service object won't work
-		// as the callbacks are bound to the initial object pointer
+		// as the server owns it and dispatches to that instance
 		// Therefore, you should never declare copy/move
 		// constructors when inheriting from IService!
 		i_service(i_service&&) = delete;
 		i_service(const i_service&) = delete;
 		i_service& operator=(const i_service&) = delete;
 
-		typedef std::function<void(i_server*, byte_buffer*)> callback;
-
 		virtual uint16_t getType() = 0;
 
-		virtual void call_service(i_server* server, const std::string& data)
+		// Only ever called from the owning server's worker
+		virtual void call_service(i_server* server, const std::string_view data)
 		{
-			std::lock_guard _(this->mutex_);
-
-			byte_buffer buffer(data);
+			byte_buffer_view buffer(data);
 			buffer.read_byte(&this->sub_type_);
 
 			printf("DW: Handling subservice of type %d\n", this->sub_type_);
 
-			const auto callback = this->callbacks_.find(this->sub_type_);
-			if (callback != this->callbacks_.end())
+			const auto& handler = this->handlers_[this->sub_type_];
+			if (handler.thunk)
 			{
-				callback->second(server, &buffer);
+				handler.thunk(this, handler.method, server, &buffer);
 			}
 			else
 			{
@@ -41,33 +44,81 @@ namespace demonware
 			}
 		}
 
-	protected:
-		std::map<uint8_t, callback> callbacks_{};
+		// Accounts a call to the last handled subservice
+		void record_call(const std::chrono::nanoseconds duration)
+		{
+			const auto& metrics = this->metrics_[this->sub_type_];
+			if (metrics) metrics->record(duration);
+		}
 
+		void print_metrics()
+		{
+			for (size_t i = 0; i < this->metrics_.size(); ++i)
+			{
+				if (!this->metrics_[i]) continue;
+
+				const auto summary = this->metrics_[i]->get_summary();
+				if (!summary.calls) continue;
+
+				printf("DW: Service %d.%zu: %llu calls, mean %.0f us, p50 %llu us, p90 %llu us, p99 %llu us, max %llu us\n",
+				       this->getType(), i, static_cast<unsigned long long>(summary.calls), summary.mean,
+				       static_cast<unsigned long long>(summary.p50), static_cast<unsigned long long>(summary.p90),
+				       static_cast<unsigned long long>(summary.p99), static_cast<unsigned long long>(summary.max));
+			}
+		}
+
+	protected:
 		template <typename Class, typename T, typename... Args>
 		void register_service(const uint8_t type, T (Class::*callback)(Args ...) const)
 		{
-			this->callbacks_[type] = [this, callback](Args ... args) -> T
-			{
-				return (reinterpret_cast<Class*>(this)->*callback)(args...);
-			};
+			this->register_handler<Class>(type, callback);
 		}
 
 		template <typename Class, typename T, typename... Args>
 		void register_service(const uint8_t type, T (Class::*callback)(Args ...))
 		{
-			this->callbacks_[type] = [this, callback](Args ... args) -> T
-			{
-				return (reinterpret_cast<Class*>(this)->*callback)(args...);
-			};
+			this->register_handler<Class>(type, callback);
 		}
 
 		uint8_t get_sub_type() const { return this->sub_type_; }
 
 	private:
-		std::mutex mutex_;
+		// Calls the member function stored in the handler, one instantiation per service class
+		using handler_thunk = void(*)(i_service* service, const void* method, i_server* server, byte_buffer_view* buffer);
+
+		struct handler
+		{
+			handler_thunk thunk = nullptr;
+
+			// The member function pointer, its size depends on the class
+			alignas(void*) char method[16]{};
+		};
 
 		uint8_t sub_type_{};
+
+		// Indexed by subservice, so dispatching is a single lookup
+		std::array<handler, 256> handlers_{};
+
+		// Only allocated for registered subservices, the table doesn't change after construction
+		std::array<std::unique_ptr<handler_metrics>, 256> metrics_{};
+
+		template <typename Class, typename Method>
+		void register_handler(const uint8_t type, const Method method)
+		{
+			static_assert(sizeof(Method) <= sizeof(handler::method), "Member function pointer doesn't fit");
+
+			if (!this->metrics_[type]) this->metrics_[type] = std::make_unique<handler_metrics>();
+
+			auto& entry = this->handlers_[type];
+			std::memcpy(entry.method, &method, sizeof(method));
+
+			entry.thunk = [](i_service* service, const void* data, i_server* server, byte_buffer_view* buffer)
+			{
+				Method callback;
+				std::memcpy(&callback, data, sizeof(callback));
+				(static_cast<Class*>(service)->*callback)(server, buffer);
+			};
+		}
 	};
 
 	template <uint16_t Type>
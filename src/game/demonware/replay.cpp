@@ -0,0 +1,160 @@
+#include <std_include.hpp>
+#include "replay.hpp"
+
+namespace demonware
+{
+	replay::replay(service_server* server) : server_(server)
+	{
+	}
+
+	void replay::add_message(const uint8_t service, byte_buffer* data)
+	{
+		this->add_message(service, data->get_buffer());
+	}
+
+	void replay::add_message(const uint8_t service, const std::string_view payload)
+	{
+		byte_buffer buffer;
+		buffer.set_use_data_types(false);
+		buffer.write_int32(static_cast<int>(payload.size()) + 2);
+		buffer.write_bool(false);
+		buffer.write_byte(service);
+		buffer.write(payload);
+
+		this->add_packet(service, std::move(buffer.get_buffer()));
+	}
+
+	void replay::add_keep_alive()
+	{
+		this->add_packet(0, std::string("\x00\x00\x00\x00", 4));
+	}
+
+	void replay::add_packet(const uint8_t service, std::string data)
+	{
+		this->packets_.push_back({service, std::move(data)});
+	}
+
+	bool replay::add_capture(const std::vector<capture::record>& records)
+	{
+		auto added = false;
+
+		for (const auto& record : records)
+		{
+			if (record.direction != capture::direction_type::incoming) continue;
+			if (record.server != this->server_->get_address()) continue;
+
+			if (record.service) this->add_message(record.service, record.data);
+			else this->add_packet(0, record.data);
+
+			added = true;
+		}
+
+		return added;
+	}
+
+	void replay::run(const size_t iterations)
+	{
+		char buffer[0x4000];
+		auto& pool = this->server_->get_buffer_pool();
+
+		for (size_t i = 0; i < iterations; ++i)
+		{
+			for (const auto& packet : this->packets_)
+			{
+				auto& entry = this->statistics_[packet.service];
+
+				const auto misses = pool.get_misses();
+				const auto start = std::chrono::steady_clock::now();
+
+				this->server_->send(packet.data.data(), static_cast<int>(packet.data.size()));
+				this->server_->run_frame();
+
+				int length;
+				while ((length = this->server_->recv(buffer, sizeof(buffer))) > 0)
+				{
+					entry.bytes_out += length;
+				}
+
+				entry.time += std::chrono::steady_clock::now() - start;
+				entry.allocations += pool.get_misses() - misses;
+				entry.bytes_in += packet.data.size();
+				++entry.messages;
+			}
+		}
+	}
+
+	const std::map<uint8_t, replay::statistics>& replay::get_statistics() const
+	{
+		return this->statistics_;
+	}
+
+	void replay::print_statistics() const
+	{
+		for (const auto& [service, entry] : this->statistics_)
+		{
+			const std::chrono::duration<double> time = entry.time;
+			const auto seconds = std::max(time.count(), 1e-9);
+
+			printf("DW: Service %3d: %llu messages, %.0f msg/s, %.2f MB/s in, %.2f MB/s out, %llu allocations\n",
+			       service, static_cast<unsigned long long>(entry.messages), double(entry.messages) / seconds,
+			       double(entry.bytes_in) / seconds / 0x100000, double(entry.bytes_out) / seconds / 0x100000,
+			       static_cast<unsigned long long>(entry.allocations));
+		}
+	}
+
+	void replay::benchmark(service_server* server)
+	{
+		replay replay(server);
+
+		replay.add_keep_alive();
+
+		// bdTitleUtilities::get_server_time
+		byte_buffer time_request;
+		time_request.write_byte(6);
+		replay.add_message(12, &time_request);
+
+		// bdStorage::list_publisher_files and get_publisher_file
+		byte_buffer list_request;
+		list_request.write_byte(6);
+		list_request.write_uint32(0);
+		list_request.write_uint16(10);
+		list_request.write_uint16(0);
+		list_request.write_string("motd-english.txt");
+		replay.add_message(10, &list_request);
+
+		byte_buffer file_request;
+		file_request.write_byte(7);
+		file_request.write_string("online_mp.img");
+		replay.add_message(10, &file_request);
+
+		// Warm up the caches and the buffer pool first
+		replay.run(16);
+		replay.statistics_.clear();
+
+		printf("DW: Running benchmark...\n");
+		replay.run(2048);
+		replay.print_statistics();
+	}
+
+	void replay::replay_capture(const std::string& path, const std::vector<std::shared_ptr<service_server>>& servers)
+	{
+		std::vector<capture::record> records;
+		if (!capture::load(path, &records))
+		{
+			printf("DW: Failed to load capture %s\n", path.data());
+			return;
+		}
+
+		printf("DW: Replaying %zu records from %s\n", records.size(), path.data());
+
+		// Stored files end up in the servers' own storage, which is in memory for offline ones
+		for (const auto& server : servers)
+		{
+			replay replay(server.get());
+			if (!replay.add_capture(records)) continue;
+
+			replay.run();
+			replay.print_statistics();
+		}
+	}
+}
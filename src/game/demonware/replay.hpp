@@ -0,0 +1,58 @@
+#pragma once
+#include "service_server.hpp"
+
+namespace demonware
+{
+	// Feeds client traffic to a server without going through the game's sockets.
+	// Runs synchronously on the calling thread, so the server must not be started.
+	class replay final
+	{
+	public:
+		struct statistics
+		{
+			uint64_t messages;
+			uint64_t bytes_in;
+			uint64_t bytes_out;
+
+			// Reply buffers the server's pool couldn't recycle
+			uint64_t allocations;
+			std::chrono::nanoseconds time;
+		};
+
+		explicit replay(service_server* server);
+
+		// Frames a plain (unencrypted) message for the given service
+		void add_message(uint8_t service, byte_buffer* data);
+		void add_message(uint8_t service, std::string_view data);
+		void add_keep_alive();
+		void add_packet(uint8_t service, std::string data);
+
+		// Queues what clients sent to this server in a recorded session, in the original order
+		bool add_capture(const std::vector<capture::record>& records);
+
+		void run(size_t iterations = 1);
+
+		// Keyed by service, control frames are accounted as 0
+		const std::map<uint8_t, statistics>& get_statistics() const;
+		void print_statistics() const;
+
+		// Measures the lobby server with synthetic traffic, enabled by -dwbenchmark
+		static void benchmark(service_server* server);
+
+		// Replays a capture against every server it has traffic for, enabled by -dwreplay.
+		// Pass servers with in-memory storage, user files the capture sets are written to it.
+		static void replay_capture(const std::string& path,
+		                           const std::vector<std::shared_ptr<service_server>>& servers);
+
+	private:
+		struct packet
+		{
+			uint8_t service;
+			std::string data;
+		};
+
+		service_server* server_;
+		std::vector<packet> packets_;
+		std::map<uint8_t, statistics> statistics_;
+	};
+}
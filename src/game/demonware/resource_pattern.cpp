@@ -0,0 +1,94 @@
+#include <std_include.hpp>
+#include "resource_pattern.hpp"
+
+namespace demonware
+{
+	resource_pattern::resource_pattern(const std::string& expression)
+	{
+		for (size_t i = 0; i < expression.size(); ++i)
+		{
+			token token{};
+
+			const auto c = expression[i];
+			if (c == '\\' && i + 1 < expression.size())
+			{
+				token.chars.set(uint8_t(expression[++i]));
+			}
+			else if (c == '.')
+			{
+				// Like ECMAScript, line terminators are the only characters it doesn't match
+				token.chars.set();
+				token.chars.reset('\n');
+				token.chars.reset('\r');
+			}
+			else if (c == '[')
+			{
+				for (++i; i < expression.size() && expression[i] != ']'; ++i)
+				{
+					const auto first = uint8_t(expression[i]);
+					auto last = first;
+
+					if (i + 2 < expression.size() && expression[i + 1] == '-' && expression[i + 2] != ']')
+					{
+						last = uint8_t(expression[i + 2]);
+						i += 2;
+					}
+
+					for (auto chr = size_t(first); chr <= last; ++chr)
+					{
+						token.chars.set(chr);
+					}
+				}
+			}
+			else
+			{
+				token.chars.set(uint8_t(c));
+			}
+
+			if (i + 1 < expression.size())
+			{
+				const auto quantifier = expression[i + 1];
+				token.optional = quantifier == '*' || quantifier == '?';
+				token.repeat = quantifier == '*' || quantifier == '+';
+
+				if (token.optional || token.repeat) ++i;
+			}
+
+			this->tokens_.push_back(token);
+		}
+	}
+
+	bool resource_pattern::match(const std::string_view name) const
+	{
+		return match(this->tokens_.data(), this->tokens_.data() + this->tokens_.size(), name);
+	}
+
+	bool resource_pattern::match(const token* current, const token* end, std::string_view name)
+	{
+		for (; current != end; ++current)
+		{
+			if (!current->optional && !current->repeat)
+			{
+				if (name.empty() || !current->chars.test(uint8_t(name.front()))) return false;
+				name.remove_prefix(1);
+				continue;
+			}
+
+			// Take as many characters as possible, then backtrack
+			size_t count = 0;
+			const auto max_count = current->repeat ? name.size() : std::min(name.size(), size_t(1));
+			while (count < max_count && current->chars.test(uint8_t(name[count]))) ++count;
+
+			const size_t min_count = current->optional ? 0 : 1;
+			if (count < min_count) return false;
+
+			for (auto taken = count;; --taken)
+			{
+				if (match(current + 1, end, name.substr(taken))) return true;
+				if (taken == min_count) return false;
+			}
+		}
+
+		return name.empty();
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <bitset>
+
+namespace demonware
+{
+	// Matches names against a small regular expression subset:
+	// literals, '\' escapes, '.', character classes like [A-Za-z]
+	// and the quantifiers '*', '+' and '?' on single characters.
+	// It's compiled once and matched without any allocation.
+	class resource_pattern final
+	{
+	public:
+		explicit resource_pattern(const std::string& expression);
+
+		bool match(std::string_view name) const;
+
+	private:
+		struct token
+		{
+			std::bitset<256> chars;
+			bool optional;
+			bool repeat;
+		};
+
+		std::vector<token> tokens_;
+
+		static bool match(const token* current, const token* end, std::string_view name);
+	};
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "i_server.hpp"
+
+namespace demonware
+{
+	// Fixed-size values, written as data type + raw bytes just like byte_buffer::write_*
+	template <typename T, char DataType>
+	struct scalar_io
+	{
+		static constexpr bool fixed = true;
+		static constexpr size_t max_size = sizeof(T) + 1;
+
+		static size_t pack(const T& value, char* output, const bool data_types)
+		{
+			size_t size = 0;
+			if (data_types) output[size++] = DataType;
+
+			std::memcpy(output + size, &value, sizeof(T));
+			return size + sizeof(T);
+		}
+
+		static bool read(byte_buffer* buffer, T* value)
+		{
+			return buffer->read_data_type(DataType) && buffer->read(sizeof(T), value);
+		}
+	};
+
+	struct string_io
+	{
+		static constexpr bool fixed = false;
+		static constexpr size_t max_size = 0;
+
+		static bool write(byte_buffer* buffer, const std::string& value)
+		{
+			return buffer->write_string(value);
+		}
+
+		static bool read(byte_buffer* buffer, std::string* value)
+		{
+			return buffer->read_string(value);
+		}
+	};
+
+	struct blob_io
+	{
+		static constexpr bool fixed = false;
+		static constexpr size_t max_size = 0;
+
+		static bool write(byte_buffer* buffer, const std::string& value)
+		{
+			return buffer->write_blob(value);
+		}
+
+		static bool read(byte_buffer* buffer, std::string* value)
+		{
+			return buffer->read_blob(value);
+		}
+	};
+
+	template <typename T>
+	struct default_io;
+
+	template <> struct default_io<bool> : scalar_io<bool, 1> {};
+	template <> struct default_io<uint8_t> : scalar_io<uint8_t, 3> {};
+	template <> struct default_io<int16_t> : scalar_io<int16_t, 5> {};
+	template <> struct default_io<uint16_t> : scalar_io<uint16_t, 6> {};
+	template <> struct default_io<int32_t> : scalar_io<int32_t, 7> {};
+	template <> struct default_io<uint32_t> : scalar_io<uint32_t, 8> {};
+	template <> struct default_io<int64_t> : scalar_io<int64_t, 9> {};
+	template <> struct default_io<uint64_t> : scalar_io<uint64_t, 10> {};
+	template <> struct default_io<float> : scalar_io<float, 13> {};
+	template <> struct default_io<std::string> : string_io {};
+
+	template <typename T>
+	struct member_type;
+
+	template <typename Class, typename T>
+	struct member_type<T Class::*>
+	{
+		using type = T;
+	};
+
+	template <auto Member, typename IO = default_io<typename member_type<decltype(Member)>::type>>
+	struct field
+	{
+		static constexpr bool fixed = IO::fixed;
+		static constexpr size_t max_size = IO::max_size;
+
+		template <typename Object>
+		static size_t pack(const Object& object, char* output, const bool data_types)
+		{
+			return IO::pack(object.*Member, output, data_types);
+		}
+
+		template <typename Object>
+		static bool write(const Object& object, byte_buffer* buffer)
+		{
+			return IO::write(buffer, object.*Member);
+		}
+
+		template <typename Object>
+		static bool read(Object& object, byte_buffer* buffer)
+		{
+			return IO::read(buffer, &(object.*Member));
+		}
+	};
+
+	template <auto Member>
+	using blob_field = field<Member, blob_io>;
+
+	// Declares the wire layout of a type once and generates both directions from it.
+	// Consecutive fixed-size fields are packed on the stack and appended in a single write.
+	template <typename... Fields>
+	class field_list final
+	{
+	public:
+		template <typename... More>
+		using append = field_list<Fields..., More...>;
+
+		template <typename Object>
+		static void serialize(const Object& object, byte_buffer* buffer)
+		{
+			const auto data_types = buffer->is_using_data_types();
+
+			char packed[(size_t(1) + ... + Fields::max_size)];
+			size_t packed_size = 0;
+
+			const auto flush = [&]()
+			{
+				if (packed_size) buffer->write(static_cast<int>(packed_size), packed);
+				packed_size = 0;
+			};
+
+			([&]()
+			{
+				if constexpr (Fields::fixed)
+				{
+					packed_size += Fields::pack(object, packed + packed_size, data_types);
+				}
+				else
+				{
+					flush();
+					Fields::write(object, buffer);
+				}
+			}(), ...);
+
+			flush();
+		}
+
+		template <typename Object>
+		static bool deserialize(Object& object, byte_buffer* buffer)
+		{
+			return (Fields::read(object, buffer) && ...);
+		}
+	};
+
+	// Implements i_serializable for a type that declares a field_list named 'fields'
+	template <typename T, typename Base = i_serializable>
+	class serializable : public Base
+	{
+	public:
+		void serialize(byte_buffer* buffer) override
+		{
+			T::fields::serialize(static_cast<const T&>(*this), buffer);
+		}
+
+		void deserialize(byte_buffer* buffer) override
+		{
+			T::fields::deserialize(static_cast<T&>(*this), buffer);
+		}
+	};
+}
@@ -1,51 +1,144 @@
 #include <std_include.hpp>
 #include "module/dw.hpp"
 #include "utils/cryptography.hpp"
+#include "utils/thread.hpp"
 
 namespace demonware
 {
-	std::string unencrypted_reply::get_data()
+	static constexpr auto reply_seed = 0x13371337;
+
+	// Larger encrypted replies are streamed, this also keeps them out of the buffer pool
+	static constexpr size_t stream_threshold = 0x10000;
+	static constexpr size_t stream_chunk_size = 0x8000;
+
+	// Encrypts a reply chunk by chunk while the client reads it.
+	// CBC carries over between chunks by using the last ciphertext block as the next IV.
+	class encrypted_stream final : public reply_stream
+	{
+	public:
+		encrypted_stream(const uint8_t type, const std::string_view header, const std::string_view data,
+		                 const std::string_view tail, std::shared_ptr<const void> tail_owner)
+			: tail_(tail), tail_owner_(std::move(tail_owner))
+		{
+			byte_buffer prefix;
+			prefix.set_use_data_types(false);
+			prefix.write_int32(0xDEADBEEF);
+			prefix.write_byte(type);
+			prefix.write(header);
+			prefix.write(data);
+
+			this->prefix_ = std::move(prefix.get_buffer());
+
+			this->size_ = this->prefix_.size() + this->tail_.size();
+			this->size_ = ~7 & (this->size_ + 7); // 8 byte align
+
+			this->cipher_ = dw::get_cipher(true);
+			this->iv_ = dw::get_iv(reply_seed);
+		}
+
+		bool read(std::string* output) override
+		{
+			if (this->offset_ >= this->size_) return false;
+
+			if (!this->offset_)
+			{
+				byte_buffer frame_header(std::move(*output));
+				frame_header.set_use_data_types(false);
+				frame_header.write_int32(static_cast<int>(this->size_) + 5);
+				frame_header.write_byte(true);
+				frame_header.write_int32(reply_seed);
+
+				*output = std::move(frame_header.get_buffer());
+			}
+
+			const auto length = std::min(stream_chunk_size, this->size_ - this->offset_);
+			const auto chunk_offset = output->size();
+
+			// New bytes are zeroed, which takes care of the padding
+			output->resize(chunk_offset + length);
+			auto* chunk = output->data() + chunk_offset;
+
+			const auto copy = [&](const std::string_view source, const size_t position)
+			{
+				const auto begin = std::max(position, this->offset_);
+				const auto end = std::min(position + source.size(), this->offset_ + length);
+				if (begin >= end) return;
+
+				std::memcpy(chunk + (begin - this->offset_), source.data() + (begin - position), end - begin);
+			};
+
+			copy(this->prefix_, 0);
+			copy(this->tail_, this->prefix_.size());
+
+			this->cipher_->encrypt(chunk, length, this->iv_);
+			this->iv_.assign(chunk + length - 8, 8);
+			this->offset_ += length;
+
+			return true;
+		}
+
+	private:
+		std::string prefix_;
+		std::string_view tail_;
+		std::shared_ptr<const void> tail_owner_;
+
+		size_t size_ = 0;
+		size_t offset_ = 0;
+
+		std::shared_ptr<const utils::cryptography::des3::context> cipher_;
+		std::string iv_;
+	};
+
+	void unencrypted_reply::get_data(std::string* output)
 	{
-		byte_buffer result;
+		byte_buffer result(std::move(*output));
 		result.set_use_data_types(false);
 
-		result.write_int32(static_cast<int>(this->buffer_.size()) + 2);
+		result.write_int32(static_cast<int>(this->header_.size() + this->buffer_.size() + this->tail_.size()) + 2);
 		result.write_bool(false);
 		result.write_byte(this->get_type());
+		result.write(this->header_);
 		result.write(this->buffer_);
+		result.write(this->tail_);
 
-		return result.get_buffer();
+		*output = std::move(result.get_buffer());
 	}
 
-	std::string encrypted_reply::get_data()
+	void encrypted_reply::get_data(std::string* output)
 	{
-		byte_buffer result;
+		byte_buffer result(std::move(*output));
 		result.set_use_data_types(false);
 
-		byte_buffer enc_buffer;
-		enc_buffer.set_use_data_types(false);
-		enc_buffer.write_int32(0xDEADBEEF);
-		enc_buffer.write_byte(this->get_type());
-		enc_buffer.write(this->buffer_);
-
-		auto data = enc_buffer.get_buffer();
-
-		auto size = enc_buffer.size();
+		auto size = 4 + 1 + this->header_.size() + this->buffer_.size() + this->tail_.size();
 		size = ~7 & (size + 7); // 8 byte align
-		data.resize(size);
 
 		result.write_int32(static_cast<int>(size) + 5);
 		result.write_byte(true);
+		result.write_int32(reply_seed);
 
-		auto seed = 0x13371337;
-		result.write_int32(seed);
+		// The plaintext is assembled in place and replaced by its ciphertext
+		const auto data_offset = result.size();
+		result.write_int32(0xDEADBEEF);
+		result.write_byte(this->get_type());
+		result.write(this->header_);
+		result.write(this->buffer_);
+		result.write(this->tail_);
 
-		const auto iv = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&seed), 4));
+		auto& data = result.get_buffer();
+		data.resize(data_offset + size);
 
-		const std::string key(reinterpret_cast<char*>(dw::get_key(true)), 24);
-		result.write(utils::cryptography::des3::encrypt(data, iv, key));
+		dw::get_cipher(true)->encrypt(data.data() + data_offset, size, dw::get_iv(reply_seed));
 
-		return result.get_buffer();
+		*output = std::move(data);
+	}
+
+	std::unique_ptr<reply_stream> encrypted_reply::get_stream()
+	{
+		const auto size = this->header_.size() + this->buffer_.size() + this->tail_.size();
+		if (size <= stream_threshold) return {};
+
+		return std::make_unique<encrypted_stream>(this->get_type(), this->header_, this->buffer_, this->tail_,
+		                                          std::move(this->tail_owner_));
 	}
 
 	service_server::service_server(std::string _name) : name_(std::move(_name))
@@ -53,6 +146,11 @@ namespace demonware
 		this->address_ = utils::cryptography::jenkins_one_at_a_time::compute(this->name_);
 	}
 
+	service_server::~service_server()
+	{
+		this->stop();
+	}
+
 	unsigned long service_server::get_address() const
 	{
 		return this->address_;
@@ -64,48 +162,102 @@ namespace demonware
 		std::lock_guard<std::recursive_mutex> _(this->mutex_);
 
 		this->incoming_queue_.push(std::string(buf, len));
+		this->work_condition_.notify_one();
 
 		return len;
 	}
 
-	int service_server::recv(char* buf, int len)
+	int service_server::recv(char* buf, const int len)
 	{
-		if (len > 0 && !this->outgoing_queue_.empty())
+		if (len <= 0) return SOCKET_ERROR;
+		std::lock_guard<std::recursive_mutex> _(this->mutex_);
+
+		auto copied = 0;
+		while (copied < len && !this->outgoing_queue_.empty())
 		{
-			std::lock_guard<std::recursive_mutex> _(this->mutex_);
+			auto& chunk = this->outgoing_queue_.front();
 
-			len = std::min(len, static_cast<int>(this->outgoing_queue_.size()));
-			for (auto i = 0; i < len; ++i)
+			if (this->outgoing_offset_ >= chunk.buffer.size())
 			{
-				buf[i] = this->outgoing_queue_.front();
-				this->outgoing_queue_.pop();
+				// Streamed replies are only produced as far as the client reads them
+				if (chunk.stream)
+				{
+					chunk.buffer.clear();
+					this->outgoing_offset_ = 0;
+
+					if (chunk.stream->read(&chunk.buffer)) continue;
+				}
+
+				this->get_buffer_pool().release(std::move(chunk.buffer));
+				this->outgoing_queue_.pop_front();
+				this->outgoing_offset_ = 0;
+				continue;
 			}
 
-			return len;
+			const auto size = std::min(size_t(len - copied), chunk.buffer.size() - this->outgoing_offset_);
+			std::memcpy(buf + copied, chunk.buffer.data() + this->outgoing_offset_, size);
+
+			copied += static_cast<int>(size);
+			this->outgoing_offset_ += size;
+
+			if (this->outgoing_offset_ >= chunk.buffer.size() && !chunk.stream)
+			{
+				this->get_buffer_pool().release(std::move(chunk.buffer));
+				this->outgoing_queue_.pop_front();
+				this->outgoing_offset_ = 0;
+			}
 		}
 
-		return SOCKET_ERROR;
+		return copied > 0 ? copied : SOCKET_ERROR;
 	}
 
 	void service_server::send_reply(reply* data)
 	{
 		if (!data) return;
 
+		if (this->capture_)
+		{
+			std::string plain_data;
+			data->get_plain_data(&plain_data);
+			this->capture_->write(capture::direction_type::outgoing, this->address_, data->get_type(), plain_data);
+		}
+
+		outgoing_data outgoing{};
+		outgoing.stream = data->get_stream();
+
+		if (!outgoing.stream)
+		{
+			outgoing.buffer = this->get_buffer_pool().acquire();
+			data->get_data(&outgoing.buffer);
+		}
+
 		std::lock_guard _(this->mutex_);
 
 		this->reply_sent_ = true;
-		const auto buffer = data->get_data();
-		for (auto& byte : buffer)
+		if (outgoing.stream || !outgoing.buffer.empty())
 		{
-			this->outgoing_queue_.push(byte);
+			this->outgoing_queue_.push_back(std::move(outgoing));
+			this->reply_condition_.notify_all();
 		}
 	}
 
-	void service_server::call_handler(const uint8_t type, const std::string& data)
+	bool service_server::wait_for_reply(const std::chrono::milliseconds timeout)
 	{
-		if (this->services_.find(type) != this->services_.end())
+		std::unique_lock<std::recursive_mutex> lock(this->mutex_);
+		return this->reply_condition_.wait_for(lock, timeout, [this]()
 		{
-			this->services_[type]->call_service(this, data);
+			return !this->outgoing_queue_.empty();
+		});
+	}
+
+	void service_server::call_handler(const uint8_t type, const std::string_view data)
+	{
+		const auto& service = this->services_[type];
+		if (service)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			service->call_service(this, data);
+			service->record_call(std::chrono::steady_clock::now() - start);
 		}
 		else
 		{
@@ -115,86 +267,179 @@ namespace demonware
 
 	void service_server::run_frame()
 	{
-		if (!this->incoming_queue_.empty())
+		// Only the worker touches it, the swap hands it the queued packets
+		auto& packets = this->processing_queue_;
+
 		{
 			std::lock_guard _(this->mutex_);
-			const auto packet = this->incoming_queue_.front();
-			this->incoming_queue_.pop();
+			packets.swap(this->incoming_queue_);
+		}
+
+		if (packets.empty()) return;
+
+		while (!packets.empty())
+		{
+			this->reassembler_.append(packets.front());
+			packets.pop();
+		}
+
+		// Each frame is decoded right before it's handled,
+		// a handler may change the key the following frames are encrypted with
+		frame_reassembler::frame frame{};
+		while (this->reassembler_.next_frame(&frame))
+		{
+			message message{};
+			if (!this->decode_frame(frame, &message)) continue;
 
-			this->parse_packet(packet);
+			try
+			{
+				this->dispatch_message(message);
+			}
+			catch (...)
+			{
+			}
 		}
 	}
 
-	void service_server::parse_packet(const std::string& packet)
+	void service_server::start()
 	{
-		byte_buffer buffer(packet);
-		buffer.set_use_data_types(false);
+		std::lock_guard _(this->mutex_);
+		if (this->worker_.joinable()) return;
 
-		try
+		this->stopping_ = false;
+		this->worker_ = utils::thread::create_named_thread("DW " + this->name_, [this]()
 		{
-			while (buffer.has_more_data())
-			{
-				int size;
-				buffer.read_int32(&size);
+			this->work();
+		});
+	}
 
-				if (size <= 0)
-				{
-					const std::string zero("\x00\x00\x00\x00", 4);
+	void service_server::stop()
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->stopping_ = true;
+		}
 
-					raw_reply reply(zero);
-					this->send_reply(&reply);
-					return;
-				}
-				else if (size == 200) // Connection id
+		this->work_condition_.notify_all();
+		if (this->worker_.joinable())
+		{
+			this->worker_.join();
+		}
+	}
+
+	void service_server::work()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::recursive_mutex> lock(this->mutex_);
+				this->work_condition_.wait(lock, [this]()
 				{
-					byte_buffer bbufer;
-					bbufer.write_uint64(0x00000000000000FD);
+					return this->stopping_ || !this->incoming_queue_.empty();
+				});
 
-					auto reply = this->create_message(4);
-					reply->send(&bbufer, false);
-					return;
-				}
+				if (this->stopping_) break;
+			}
 
-				if (buffer.size() < size_t(size)) return;
+			this->run_frame();
+		}
+	}
 
-				byte_buffer p_buffer;
-				p_buffer.set_use_data_types(false);
-				p_buffer.get_buffer().resize(size);
-				buffer.read(size, p_buffer.get_buffer().data());
+	frame_reassembler::statistics service_server::get_statistics() const
+	{
+		return this->reassembler_.get_statistics();
+	}
 
-				bool enc;
-				p_buffer.read_bool(&enc);
+	void service_server::print_metrics()
+	{
+		const auto statistics = this->get_statistics();
+		printf("DW: Server %s: %llu frames, %llu bytes, %.0f frames/s, %.2f MB/s\n", this->name_.data(),
+		       static_cast<unsigned long long>(statistics.frames), static_cast<unsigned long long>(statistics.bytes),
+		       statistics.frames_per_second, statistics.bytes_per_second / 0x100000);
 
-				if (enc)
-				{
-					int iv;
-					p_buffer.read_int32(&iv);
+		for (const auto& service : this->services_)
+		{
+			if (service) service->print_metrics();
+		}
+	}
 
-					auto iv_hash = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&iv), 4));
+	void service_server::set_capture(std::shared_ptr<capture> capture)
+	{
+		this->capture_ = std::move(capture);
+	}
 
-					const std::string key(reinterpret_cast<char*>(dw::get_key(false)), 24);
-					p_buffer = byte_buffer{utils::cryptography::des3::decrypt(p_buffer.get_remaining(), iv_hash, key)};
-					p_buffer.set_use_data_types(false);
+	bool service_server::decode_frame(const frame_reassembler::frame& frame, message* message)
+	{
+		message->type = frame.type;
 
-					int checksum;
-					p_buffer.read_int32(&checksum);
-				}
+		if (frame.type == frame_reassembler::frame_type::message)
+		{
+			byte_buffer_view buffer(std::string_view(frame.data, frame.size));
+			buffer.set_use_data_types(false);
 
-				uint8_t type;
-				p_buffer.read_byte(&type);
-				printf("DW: Handling message of type %d (encrypted: %d)\n", type, enc);
+			if (!buffer.read_bool(&message->encrypted)) return false;
 
-				this->reply_sent_ = false;
-				this->call_handler(type, p_buffer.get_remaining());
+			if (message->encrypted)
+			{
+				int iv;
+				if (!buffer.read_int32(&iv)) return false;
 
-				if (!this->reply_sent_ && type != 7)
-				{
-					this->create_reply(type)->send();
-				}
+				// The reassembler owns the frame, so it can be decrypted in place
+				const auto size = buffer.get_remaining().size();
+				auto* data = frame.data + (frame.size - size);
+				dw::get_cipher(false)->decrypt(data, size, dw::get_iv(iv));
+
+				buffer = byte_buffer_view(std::string_view(data, size));
+				buffer.set_use_data_types(false);
+
+				int checksum;
+				if (!buffer.read_int32(&checksum)) return false;
 			}
+
+			if (!buffer.read_byte(&message->service)) return false;
+			message->data = buffer.get_remaining();
 		}
-		catch (...)
+
+		return true;
+	}
+
+	void service_server::dispatch_message(const message& message)
+	{
+		if (this->capture_)
+		{
+			// Control frames are stored as they would be sent, so they can be replayed as they are
+			std::string_view data = message.data;
+			if (message.type == frame_reassembler::frame_type::keep_alive) data = {"\x00\x00\x00\x00", 4};
+			if (message.type == frame_reassembler::frame_type::connection_id) data = {"\xC8\x00\x00\x00", 4};
+
+			const uint8_t service = message.type == frame_reassembler::frame_type::message ? message.service : 0;
+			this->capture_->write(capture::direction_type::incoming, this->address_, service, data);
+		}
+
+		if (message.type == frame_reassembler::frame_type::keep_alive)
+		{
+			raw_reply reply(std::string_view("\x00\x00\x00\x00", 4));
+			this->send_reply(&reply);
+			return;
+		}
+
+		if (message.type == frame_reassembler::frame_type::connection_id)
+		{
+			byte_buffer bbufer;
+			bbufer.write_uint64(0x00000000000000FD);
+
+			this->create_message(4).send(&bbufer, false);
+			return;
+		}
+
+		printf("DW: Handling message of type %d (encrypted: %d)\n", message.service, message.encrypted);
+
+		this->reply_sent_ = false;
+		this->call_handler(message.service, message.data);
+
+		if (!this->reply_sent_ && message.service != 7)
 		{
+			this->create_reply(message.service).send();
 		}
 	}
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "i_service.hpp"
+#include "frame_reassembler.hpp"
+#include "capture.hpp"
 
 namespace demonware
 {
@@ -7,15 +9,24 @@ namespace demonware
 	{
 	public:
 		explicit service_server(std::string name);
+		~service_server();
 
-		template <typename T>
-		void register_service()
+		template <typename T, typename... Args>
+		void register_service(Args&&... args)
 		{
 			static_assert(std::is_base_of<i_service, T>::value, "Service must inherit from IService");
 
-			auto service = std::make_unique<T>();
+			auto service = std::make_unique<T>(std::forward<Args>(args)...);
 			const uint16_t type = service->getType();
 
+			// Messages only carry a byte for the service type, such a service could never be called
+			if (type >= this->services_.size())
+			{
+				printf("DW: Service %d of server %s is out of range\n", type, this->name_.data());
+				assert(false && "Service type has to fit into a byte");
+				return;
+			}
+
 			this->services_[type] = std::move(service);
 		}
 
@@ -25,19 +36,66 @@ namespace demonware
 		int recv(char* buf, int len) override;
 		void send_reply(reply* data) override;
 
-		void call_handler(uint8_t type, const std::string& data);
+		bool wait_for_reply(std::chrono::milliseconds timeout);
+
+		void call_handler(uint8_t type, std::string_view data);
 		void run_frame();
 
+		// Every server runs its services on its own worker,
+		// so a slow handler only stalls its own clients
+		void start();
+		void stop();
+
+		frame_reassembler::statistics get_statistics() const;
+
+		// Safe to call while the server is running
+		void print_metrics();
+
+		// Has to be set before the server is started
+		void set_capture(std::shared_ptr<capture> capture);
+
 	private:
+		struct message
+		{
+			frame_reassembler::frame_type type;
+			uint8_t service;
+			bool encrypted;
+			std::string_view data;
+		};
+
 		std::string name_;
 
 		std::recursive_mutex mutex_;
-		std::queue<char> outgoing_queue_;
+		std::condition_variable_any reply_condition_;
+		std::condition_variable_any work_condition_;
+		struct outgoing_data
+		{
+			std::string buffer;
+
+			// Refills the buffer until the reply is complete
+			std::unique_ptr<reply_stream> stream;
+		};
+
+		std::deque<outgoing_data> outgoing_queue_;
+		size_t outgoing_offset_ = 0;
 		std::queue<std::string> incoming_queue_;
-		std::map<uint16_t, std::unique_ptr<i_service>> services_;
+
+		// Swapped with incoming_queue_ each frame, so neither has to allocate again
+		std::queue<std::string> processing_queue_;
+		std::array<std::unique_ptr<i_service>, 256> services_{};
 		unsigned long address_ = 0;
 		bool reply_sent_ = false;
 
-		void parse_packet(const std::string& packet);
+		bool stopping_ = false;
+		std::thread worker_;
+
+		frame_reassembler reassembler_;
+
+		std::shared_ptr<capture> capture_;
+
+		bool decode_frame(const frame_reassembler::frame& frame, message* message);
+		void dispatch_message(const message& message);
+
+		void work();
 	};
 }
@@ -1,11 +1,22 @@
 #pragma once
 #include "../i_service.hpp"
+#include "game/structs.hpp"
 
 namespace demonware
 {
 	class bdDediRSAAuth final : public i_generic_service<26>
 	{
 	public:
-		void call_service(i_server* server, const std::string& data) override;
+		bdDediRSAAuth();
+
+		void call_service(i_server* server, std::string_view data) override;
+
+	private:
+		// Everything that doesn't depend on the request is prepared once
+		game::native::bdAuthTicket ticket_template_{};
+		uint8_t lsg_ticket_[128]{};
+
+		// The CD key encrypted for each public key seen so far
+		std::unordered_map<std::string, std::string> encrypted_keys_;
 	};
 }
@@ -2,13 +2,28 @@
 #include "bdSteamAuth.hpp"
 #include "game/structs.hpp"
 #include "steam/steam.hpp"
+#include "module/dw.hpp"
 #include "utils/cryptography.hpp"
 
 namespace demonware
 {
-	void bdSteamAuth::call_service(i_server* server, const std::string& data)
+	bdSteamAuth::bdSteamAuth()
 	{
-		bit_buffer buffer(data);
+		std::memset(&this->ticket_template_, 0xA, sizeof this->ticket_template_);
+
+		this->ticket_template_.m_magicNumber = 0x0EFBDADDE;
+		this->ticket_template_.m_type = 0;
+
+		const auto key = utils::cryptography::tiger::compute("Open-IW5");
+
+		strcpy_s(this->ticket_template_.m_username, "Open-IW5 User");
+		std::memcpy(this->ticket_template_.m_sessionKey, key.data(), 24);
+		std::memcpy(this->lsg_ticket_, key.data(), 24);
+	}
+
+	void bdSteamAuth::call_service(i_server* server, const std::string_view data)
+	{
+		bit_buffer buffer{std::string(data)};
 
 		bool more_data;
 		buffer.set_use_data_types(false);
@@ -23,25 +38,12 @@ namespace demonware
 		uint8_t ticket[1024];
 		buffer.read_bytes(std::min(ticket_size, static_cast<uint32_t>(sizeof(ticket))), ticket);
 
-		game::native::bdAuthTicket auth_ticket{};
-		std::memset(&auth_ticket, 0xA, sizeof auth_ticket);
-
-		auth_ticket.m_magicNumber = 0x0EFBDADDE;
-		auth_ticket.m_type = 0;
+		auto auth_ticket = this->ticket_template_;
 		auth_ticket.m_titleID = title_id;
 		auth_ticket.m_userID = steam::SteamUser()->GetSteamID().bits;
-
-		auto key = utils::cryptography::tiger::compute("Open-IW5");
-
-		strcpy_s(auth_ticket.m_username, "Open-IW5 User");
-		std::memcpy(auth_ticket.m_sessionKey, key.data(), 24);
 		auth_ticket.m_timeIssued = static_cast<uint32_t>(time(nullptr));
 
-		uint8_t lsg_ticket[128];
-		ZeroMemory(&lsg_ticket, sizeof lsg_ticket);
-		std::memcpy(lsg_ticket, key.data(), 24);
-
-		const auto iv = utils::cryptography::tiger::compute(std::string(reinterpret_cast<char*>(&seed), 4));
+		const auto iv = dw::get_iv(seed);
 
 		const std::string enc_key(reinterpret_cast<char*>(&ticket[32]), 24);
 		auto enc_ticket = utils::cryptography::des3::encrypt(
@@ -53,9 +55,9 @@ namespace demonware
 		response.write_uint32(700);
 		response.write_uint32(seed);
 		response.write_bytes(enc_ticket.size(), enc_ticket.data());
-		response.write_bytes(sizeof(lsg_ticket), lsg_ticket);
+		response.write_bytes(sizeof(this->lsg_ticket_), this->lsg_ticket_);
 
 		auto reply = server->create_message(29);
-		reply->send(&response, false);
+		reply.send(&response, false);
 	}
 }
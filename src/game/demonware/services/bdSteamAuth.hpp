@@ -1,11 +1,19 @@
 #pragma once
 #include "../i_service.hpp"
+#include "game/structs.hpp"
 
 namespace demonware
 {
 	class bdSteamAuth final : public i_generic_service<28>
 	{
 	public:
-		void call_service(i_server* server, const std::string& data) override;
+		bdSteamAuth();
+
+		void call_service(i_server* server, std::string_view data) override;
+
+	private:
+		// Everything that doesn't depend on the request is prepared once
+		game::native::bdAuthTicket ticket_template_{};
+		uint8_t lsg_ticket_[128]{};
 	};
 }
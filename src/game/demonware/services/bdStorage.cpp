@@ -3,12 +3,26 @@
 #include "../data_types.hpp"
 #include "utils/cryptography.hpp"
 #include "utils/nt.hpp"
-#include "utils/io.hpp"
 #include "utils/string.hpp"
 
 namespace demonware
 {
-	bdStorage::bdStorage()
+	// Names starting with this are kept for the emulator's own data, clients can't store or load them
+	static constexpr char reserved_prefix = '.';
+
+	// Original names of legacy files, they're only stored as the id derived from them
+	static const std::string legacy_filenames = ".legacy_filenames";
+
+	static bool is_reserved_name(const std::string& name)
+	{
+		return !name.empty() && name[0] == reserved_prefix;
+	}
+
+	bdStorage::bdStorage() : bdStorage(user_storage::create_backend())
+	{
+	}
+
+	bdStorage::bdStorage(std::unique_ptr<storage_backend> backend) : user_storage_(std::move(backend))
 	{
 		this->register_service(1, &bdStorage::set_legacy_user_file);
 		this->register_service(3, &bdStorage::get_legacy_user_file);
@@ -20,11 +34,16 @@ namespace demonware
 		this->register_service(11, &bdStorage::delete_user_file);
 		this->register_service(12, &bdStorage::get_user_file);
 
+		// Batched variants of 12 and 10, a whole profile in one round trip
+		this->register_service(13, &bdStorage::get_user_files);
+		this->register_service(14, &bdStorage::set_user_files);
+
 		this->map_publisher_resource("heatmap\\.raw", DW_HEATMAP);
 		this->map_publisher_resource("motd-.*\\.txt", DW_MOTD);
 		this->map_publisher_resource("online_mp\\.img", DW_IMG);
 		this->map_publisher_resource("online_[Tt][Uu][0-9]+_mp_.+\\.wad", DW_WAD);
-		this->map_publisher_resource("playlists(_.+)?\\.aggr", DW_PLAYLIST);
+		this->map_publisher_resource("playlists\\.aggr", DW_PLAYLIST);
+		this->map_publisher_resource("playlists_.+\\.aggr", DW_PLAYLIST);
 		this->map_publisher_resource("social_[Tt][Uu][0-9]+\\.cfg", DW_CONFIG);
 		this->map_publisher_resource("iotd-.*\\.txt", DW_IOTD_TXT);
 		this->map_publisher_resource("iotd-.*\\.jpg", DW_IOTD_IMG);
@@ -32,26 +51,60 @@ namespace demonware
 
 	void bdStorage::map_publisher_resource(const std::string& expression, const INT id)
 	{
-		const auto res = FindResource(::utils::nt::library(), MAKEINTRESOURCE(id), RT_RCDATA);
-		if (!res) return;
+		const auto data = utils::nt::get_resource(id);
+		if (!data.data()) return;
+
+		publisher_resources_.emplace_back(resource_pattern{expression}, data);
+	}
+
+	std::string_view bdStorage::find_publisher_override(const std::string& name)
+	{
+		// Don't let the client reach outside of the override folder
+		if (name.empty() || name.find_first_of("/\\:") != std::string::npos || name.find("..") != std::string::npos)
+		{
+			return {};
+		}
 
-		const auto handle = LoadResource(nullptr, res);
-		if (!handle) return;
+		// Mappings are kept, streamed replies may still reference them
+		auto override = this->publisher_overrides_.find(name);
+		if (override == this->publisher_overrides_.end())
+		{
+			auto file = utils::nt::mapped_file("players2/publisher/" + name);
+			if (!file.is_valid()) return {};
 
-		std::string data(LPSTR(LockResource(handle)), SizeofResource(nullptr, res));
+			override = this->publisher_overrides_.emplace(name, std::move(file)).first;
+		}
 
-		publisher_resources_.emplace_back(std::regex{expression}, data);
+		return override->second.get_data();
 	}
 
-	bool bdStorage::load_publisher_resource(const std::string& name, std::string& buffer)
+	bool bdStorage::load_publisher_resource(const std::string& name, std::string_view* data)
 	{
-		for (const auto& resource : this->publisher_resources_)
+		auto lookup = this->publisher_lookup_.find(name);
+		if (lookup == this->publisher_lookup_.end())
 		{
-			if (std::regex_match(name, resource.first))
+			auto resource_data = this->find_publisher_override(name);
+			if (!resource_data.data())
 			{
-				buffer = resource.second;
-				return true;
+				for (const auto& resource : this->publisher_resources_)
+				{
+					if (resource.first.match(name))
+					{
+						resource_data = resource.second;
+						break;
+					}
+				}
 			}
+
+			// The game only asks for a handful of names, don't let anything else pile up
+			if (this->publisher_lookup_.size() >= 256) this->publisher_lookup_.clear();
+			lookup = this->publisher_lookup_.emplace(name, resource_data).first;
+		}
+
+		if (lookup->second.data())
+		{
+			*data = lookup->second;
+			return true;
 		}
 
 		printf("DW: Missing publisher file: %s\n", name.data());
@@ -59,12 +112,7 @@ namespace demonware
 		return false;
 	}
 
-	std::string bdStorage::get_user_file_path(const std::string& name)
-	{
-		return "players2/user/" + name;
-	}
-
-	void bdStorage::set_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::set_legacy_user_file(i_server* server, byte_buffer_view* buffer)
 	{
 		bool priv;
 		std::string filename, data;
@@ -73,30 +121,30 @@ namespace demonware
 		buffer->read_bool(&priv);
 		buffer->read_blob(&data);
 
-		const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
+		const auto id = user_storage::get_file_id(filename);
 		std::string id_string = utils::string::va("%llX", id);
 
 		printf("DW: Storing user file '%s' as %s\n", filename.data(), id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		utils::io::write_file(path, data);
+		this->user_storage_.write(id_string, data);
+		this->add_legacy_file(id_string, id, filename);
 
-		auto info = new bdFileInfo;
+		bdFileInfo info{};
 
-		info->file_id = id;
-		info->filename = filename;
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = 0;
-		info->priv = priv;
+		info.file_id = id;
+		info.filename = filename;
+		info.create_time = uint32_t(time(nullptr));
+		info.modified_time = info.create_time;
+		info.file_size = uint32_t(data.size());
+		info.owner_id = 0;
+		info.priv = priv;
 
 		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
-		reply->send();
+		reply.add(info);
+		reply.send();
 	}
 
-	void bdStorage::update_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::update_legacy_user_file(i_server* server, byte_buffer_view* buffer)
 	{
 		uint64_t id;
 		std::string data;
@@ -108,53 +156,56 @@ namespace demonware
 
 		printf("DW: Updating user file %s\n", id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		utils::io::write_file(path, data);
+		this->user_storage_.write(id_string, data);
+		this->add_legacy_file(id_string, id, {});
 
-		auto info = new bdFileInfo;
+		bdFileInfo info{};
 
-		info->file_id = id;
-		info->filename = "<>";
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = 0;
-		info->priv = false;
+		info.file_id = id;
+		info.filename = "<>";
+		info.create_time = uint32_t(time(nullptr));
+		info.modified_time = info.create_time;
+		info.file_size = uint32_t(data.size());
+		info.owner_id = 0;
+		info.priv = false;
 
 		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
-		reply->send();
+		reply.add(info);
+		reply.send();
 	}
 
-	void bdStorage::get_legacy_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::get_legacy_user_file(i_server* server, byte_buffer_view* buffer)
 	{
-		std::string filename, data;
+		std::string filename;
 		buffer->read_string(&filename);
 
-		const auto id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
+		const auto id = user_storage::get_file_id(filename);
 		std::string id_string = utils::string::va("%llX", id);
 
 		printf("DW: Loading user file: %s (%s)\n", filename.data(), id_string.data());
 
-		const auto path = get_user_file_path(id_string);
-		if (utils::io::read_file(path, &data))
+		auto unreadable = false;
+		const auto data = this->user_storage_.read(id_string, &unreadable);
+		if (data)
 		{
 			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
-			reply->send();
+			reply.add_file(*data, data);
+			reply.send();
 		}
 		else
 		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
+			// Telling the client the file is missing would make it overwrite it with a fresh one
+			const auto error = unreadable ? game::native::BD_EXTERNAL_STORAGE_SERVICE_ERROR : game::native::BD_NO_FILE;
+			server->create_reply(this->get_sub_type(), error).send();
 		}
 	}
 
-	void bdStorage::list_legacy_user_files(i_server* server, byte_buffer* buffer) const
+	void bdStorage::list_legacy_user_files(i_server* server, byte_buffer_view* buffer)
 	{
 		uint64_t unk;
 		uint32_t date;
 		uint16_t num_results, offset;
-		std::string filename, data;
+		std::string filename;
 
 		buffer->read_uint64(&unk);
 		buffer->read_uint32(&date);
@@ -164,30 +215,116 @@ namespace demonware
 
 		auto reply = server->create_reply(this->get_sub_type());
 
-		const auto path = get_user_file_path(filename);
-		if (utils::io::read_file(path, &data))
+		if (!filename.empty())
 		{
-			auto* info = new bdFileInfo;
+			const auto id = user_storage::get_file_id(filename);
+			this->add_legacy_file_info(&reply, utils::string::va("%llX", id), {id, filename});
+		}
+		else
+		{
+			// No name means list every legacy file, a page at a time
+			this->load_legacy_files();
+
+			auto file = this->legacy_files_.begin();
+			std::advance(file, std::min(size_t(offset), this->legacy_files_.size()));
+
+			for (uint16_t count = 0; file != this->legacy_files_.end() && count < num_results; ++file)
+			{
+				if (this->add_legacy_file_info(&reply, file->first, file->second)) ++count;
+			}
+		}
+
+		reply.send();
+	}
+
+	void bdStorage::load_legacy_files()
+	{
+		if (this->legacy_files_loaded_) return;
+		this->legacy_files_loaded_ = true;
+
+		for (const auto& name : this->user_storage_.list(0, SIZE_MAX))
+		{
+			uint64_t id;
+			if (parse_legacy_name(name, &id)) this->legacy_files_[name].id = id;
+		}
+
+		const auto filenames = this->user_storage_.read(legacy_filenames);
+		if (!filenames) return;
+
+		// One "<stored name>\t<filename>" line per file
+		std::string_view lines = *filenames;
+		while (!lines.empty())
+		{
+			const auto line = lines.substr(0, lines.find('\n'));
+			lines.remove_prefix(std::min(lines.size(), line.size() + 1));
 
-			info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
-			info->filename = filename;
-			info->create_time = 0;
-			info->modified_time = info->create_time;
-			info->file_size = uint32_t(data.size());
-			info->owner_id = 0;
-			info->priv = false;
+			const auto separator = line.find('\t');
+			if (separator == std::string_view::npos) continue;
 
-			reply->add(info);
+			const auto file = this->legacy_files_.find(std::string(line.substr(0, separator)));
+			if (file != this->legacy_files_.end()) file->second.filename = line.substr(separator + 1);
 		}
+	}
+
+	void bdStorage::add_legacy_file(const std::string& stored_name, const uint64_t id, const std::string& filename)
+	{
+		this->load_legacy_files();
+
+		auto& file = this->legacy_files_[stored_name];
+		file.id = id;
+
+		if (filename.empty() || filename == file.filename) return;
+		if (filename.find_first_of("\t\n") != std::string::npos) return;
+
+		file.filename = filename;
+
+		std::string filenames;
+		for (const auto& entry : this->legacy_files_)
+		{
+			if (!entry.second.filename.empty()) filenames += entry.first + '\t' + entry.second.filename + '\n';
+		}
+
+		this->user_storage_.write(legacy_filenames, std::move(filenames));
+	}
+
+	bool bdStorage::add_legacy_file_info(service_reply* reply, const std::string& stored_name, const legacy_file& file)
+	{
+		user_storage::file_info file_info{};
+		if (!this->user_storage_.get_info(stored_name, &file_info)) return false;
+
+		bdFileInfo info{};
+
+		info.file_id = file.id;
+		info.filename = file.filename.empty() ? stored_name : file.filename;
+		info.create_time = 0;
+		info.modified_time = file_info.modified_time;
+		info.file_size = file_info.size;
+		info.owner_id = 0;
+		info.priv = false;
 
-		reply->send();
+		reply->add(info);
+		return true;
+	}
+
+	bool bdStorage::parse_legacy_name(const std::string& name, uint64_t* id)
+	{
+		// Legacy files are stored under their id formatted as %llX, other names come from subservice 10
+		if (name.empty() || name.size() > 16) return false;
+
+		char* end = nullptr;
+		const auto value = std::strtoull(name.data(), &end, 16);
+		if (end != name.data() + name.size() || utils::string::va("%llX", value) != name) return false;
+
+		*id = value;
+		return true;
 	}
 
-	void bdStorage::list_publisher_files(i_server* server, byte_buffer* buffer)
+	void bdStorage::list_publisher_files(i_server* server, byte_buffer_view* buffer)
 	{
 		uint32_t date;
 		uint16_t num_results, offset;
-		std::string filename, data;
+		std::string filename;
+		std::string_view data;
 
 		buffer->read_uint32(&date);
 		buffer->read_uint16(&num_results);
@@ -196,45 +333,45 @@ namespace demonware
 
 		auto reply = server->create_reply(this->get_sub_type());
 
-		if (this->load_publisher_resource(filename, data))
+		if (this->load_publisher_resource(filename, &data))
 		{
-			auto* info = new bdFileInfo;
+			bdFileInfo info{};
 
-			info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
-			info->filename = filename;
-			info->create_time = 0;
-			info->modified_time = info->create_time;
-			info->file_size = uint32_t(data.size());
-			info->owner_id = 0;
-			info->priv = false;
+			info.file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
+			info.filename = filename;
+			info.create_time = 0;
+			info.modified_time = info.create_time;
+			info.file_size = uint32_t(data.size());
+			info.owner_id = 0;
+			info.priv = false;
 
-			reply->add(info);
+			reply.add(info);
 		}
 
-		reply->send();
+		reply.send();
 	}
 
-	void bdStorage::get_publisher_file(i_server* server, byte_buffer* buffer)
+	void bdStorage::get_publisher_file(i_server* server, byte_buffer_view* buffer)
 	{
 		std::string filename;
 		buffer->read_string(&filename);
 
 		printf("DW: Loading publisher file: %s\n", filename.data());
 
-		std::string data;
-		if (this->load_publisher_resource(filename, data))
+		std::string_view data;
+		if (this->load_publisher_resource(filename, &data))
 		{
 			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
-			reply->send();
+			reply.add_file(data);
+			reply.send();
 		}
 		else
 		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
+			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE).send();
 		}
 	}
 
-	void bdStorage::delete_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::delete_user_file(i_server* server, byte_buffer_view* buffer) const
 	{
 		uint64_t owner;
 		std::string game, filename;
@@ -246,10 +383,10 @@ namespace demonware
 		// Really remove the file?
 
 		auto reply = server->create_reply(this->get_sub_type());
-		reply->send();
+		reply.send();
 	}
 
-	void bdStorage::set_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::set_user_file(i_server* server, byte_buffer_view* buffer)
 	{
 		bool priv;
 		uint64_t owner;
@@ -261,44 +398,146 @@ namespace demonware
 		buffer->read_blob(&data);
 		buffer->read_uint64(&owner);
 
-		const auto path = get_user_file_path(filename);
-		utils::io::write_file(path, data);
+		if (is_reserved_name(filename))
+		{
+			server->create_reply(this->get_sub_type(), game::native::BD_PERMISSION_DENIED).send();
+			return;
+		}
+
+		this->user_storage_.write(filename, data);
 
-		auto* info = new bdFileInfo;
+		bdFileInfo info{};
 
-		info->file_id = *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(filename).data());
-		info->filename = filename;
-		info->create_time = uint32_t(time(nullptr));
-		info->modified_time = info->create_time;
-		info->file_size = uint32_t(data.size());
-		info->owner_id = owner;
-		info->priv = priv;
+		info.file_id = user_storage::get_file_id(filename);
+		info.filename = filename;
+		info.create_time = uint32_t(time(nullptr));
+		info.modified_time = info.create_time;
+		info.file_size = uint32_t(data.size());
+		info.owner_id = owner;
+		info.priv = priv;
 
 		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(info);
-		reply->send();
+		reply.add(info);
+		reply.send();
 	}
 
-	void bdStorage::get_user_file(i_server* server, byte_buffer* buffer) const
+	void bdStorage::get_user_file(i_server* server, byte_buffer_view* buffer)
 	{
 		uint64_t owner{};
-		std::string game, filename, platform, data;
+		std::string game, filename, platform;
 
 		buffer->read_string(&game);
 		buffer->read_string(&filename);
 		buffer->read_uint64(&owner);
 		buffer->read_string(&platform);
 
-		const auto path = get_user_file_path(filename);
-		if (utils::io::read_file(path, &data))
+		if (is_reserved_name(filename))
+		{
+			server->create_reply(this->get_sub_type(), game::native::BD_PERMISSION_DENIED).send();
+			return;
+		}
+
+		auto unreadable = false;
+		const auto data = this->user_storage_.read(filename, &unreadable);
+		if (data)
 		{
 			auto reply = server->create_reply(this->get_sub_type());
-			reply->add(new bdFileData(data));
-			reply->send();
+			reply.add_file(*data, data);
+			reply.send();
 		}
 		else
 		{
-			server->create_reply(this->get_sub_type(), game::native::BD_NO_FILE)->send();
+			const auto error = unreadable ? game::native::BD_EXTERNAL_STORAGE_SERVICE_ERROR : game::native::BD_NO_FILE;
+			server->create_reply(this->get_sub_type(), error).send();
 		}
 	}
+
+	void bdStorage::get_user_files(i_server* server, byte_buffer_view* buffer)
+	{
+		uint64_t owner{};
+		std::string game, platform;
+
+		buffer->read_string(&game);
+		buffer->read_uint64(&owner);
+		buffer->read_string(&platform);
+
+		auto reply = server->create_reply(this->get_sub_type());
+
+		// Answers every requested file at once, missing ones are left out
+		std::string filename;
+		while (buffer->has_more_data() && buffer->read_string(&filename))
+		{
+			if (is_reserved_name(filename))
+			{
+				server->create_reply(this->get_sub_type(), game::native::BD_PERMISSION_DENIED).send();
+				return;
+			}
+
+			auto unreadable = false;
+			const auto data = this->user_storage_.read(filename, &unreadable);
+
+			// Leaving it out would make the client think it's missing
+			if (unreadable)
+			{
+				server->create_reply(this->get_sub_type(), game::native::BD_EXTERNAL_STORAGE_SERVICE_ERROR).send();
+				return;
+			}
+
+			if (!data) continue;
+
+			bdNamedFileData file{};
+			file.filename = filename;
+			file.file_data = *data;
+
+			reply.add(file);
+		}
+
+		reply.send();
+	}
+
+	void bdStorage::set_user_files(i_server* server, byte_buffer_view* buffer)
+	{
+		bool priv;
+		uint64_t owner;
+		std::string game;
+
+		buffer->read_string(&game);
+		buffer->read_uint64(&owner);
+		buffer->read_bool(&priv);
+
+		// Nothing is stored unless every file is acceptable
+		std::vector<std::pair<std::string, std::string>> files;
+
+		std::string filename, data;
+		while (buffer->has_more_data() && buffer->read_string(&filename) && buffer->read_blob(&data))
+		{
+			if (is_reserved_name(filename))
+			{
+				server->create_reply(this->get_sub_type(), game::native::BD_PERMISSION_DENIED).send();
+				return;
+			}
+
+			files.emplace_back(std::move(filename), std::move(data));
+		}
+
+		auto reply = server->create_reply(this->get_sub_type());
+
+		for (auto& file : files)
+		{
+			bdFileInfo info{};
+
+			info.file_id = user_storage::get_file_id(file.first);
+			info.filename = file.first;
+			info.create_time = uint32_t(time(nullptr));
+			info.modified_time = info.create_time;
+			info.file_size = uint32_t(file.second.size());
+			info.owner_id = owner;
+			info.priv = priv;
+
+			this->user_storage_.write(file.first, std::move(file.second));
+			reply.add(info);
+		}
+
+		reply.send();
+	}
 }
@@ -1,5 +1,9 @@
 #pragma once
 #include "../i_service.hpp"
+#include "../user_storage.hpp"
+#include "../resource_pattern.hpp"
+
+#include "utils/nt.hpp"
 
 namespace demonware
 {
@@ -7,23 +11,50 @@ namespace demonware
 	{
 	public:
 		bdStorage();
+		explicit bdStorage(std::unique_ptr<storage_backend> backend);
 
 	private:
-		std::vector<std::pair<std::regex, std::string>> publisher_resources_;
-
-		void set_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void update_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void get_legacy_user_file(i_server* server, byte_buffer* buffer) const;
-		void list_legacy_user_files(i_server* server, byte_buffer* buffer) const;
-		void list_publisher_files(i_server* server, byte_buffer* buffer);
-		void get_publisher_file(i_server* server, byte_buffer* buffer);
-		void delete_user_file(i_server* server, byte_buffer* buffer) const;
-		void set_user_file(i_server* server, byte_buffer* buffer) const;
-		void get_user_file(i_server* server, byte_buffer* buffer) const;
+		// Views into the module's resources, nothing is copied
+		std::vector<std::pair<resource_pattern, std::string_view>> publisher_resources_;
 
-		void map_publisher_resource(const std::string& expression, INT id);
-		bool load_publisher_resource(const std::string& name, std::string& buffer);
+		// Files from players2/publisher replace the built-in resources
+		std::unordered_map<std::string, utils::nt::mapped_file> publisher_overrides_;
+
+		// Requested names resolve to the same data every time, misses are remembered as a null view
+		std::unordered_map<std::string, std::string_view> publisher_lookup_;
+		user_storage user_storage_;
+
+		struct legacy_file
+		{
+			uint64_t id;
+
+			// Only known for files stored since their names are kept
+			std::string filename;
+		};
 
-		static std::string get_user_file_path(const std::string& name);
+		// Legacy files by their stored name, loaded on the first listing
+		std::map<std::string, legacy_file> legacy_files_;
+		bool legacy_files_loaded_ = false;
+
+		void set_legacy_user_file(i_server* server, byte_buffer_view* buffer);
+		void update_legacy_user_file(i_server* server, byte_buffer_view* buffer);
+		void get_legacy_user_file(i_server* server, byte_buffer_view* buffer);
+		void list_legacy_user_files(i_server* server, byte_buffer_view* buffer);
+		void list_publisher_files(i_server* server, byte_buffer_view* buffer);
+		void get_publisher_file(i_server* server, byte_buffer_view* buffer);
+		void delete_user_file(i_server* server, byte_buffer_view* buffer) const;
+		void set_user_file(i_server* server, byte_buffer_view* buffer);
+		void get_user_file(i_server* server, byte_buffer_view* buffer);
+		void get_user_files(i_server* server, byte_buffer_view* buffer);
+		void set_user_files(i_server* server, byte_buffer_view* buffer);
+
+		void load_legacy_files();
+		void add_legacy_file(const std::string& stored_name, uint64_t id, const std::string& filename);
+		bool add_legacy_file_info(service_reply* reply, const std::string& stored_name, const legacy_file& file);
+		static bool parse_legacy_name(const std::string& name, uint64_t* id);
+
+		void map_publisher_resource(const std::string& expression, INT id);
+		std::string_view find_publisher_override(const std::string& name);
+		bool load_publisher_resource(const std::string& name, std::string_view* data);
 	};
 }
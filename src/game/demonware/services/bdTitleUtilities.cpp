@@ -9,13 +9,13 @@ namespace demonware
 		this->register_service(6, &bdTitleUtilities::get_server_time);
 	}
 
-	void bdTitleUtilities::get_server_time(i_server* server, byte_buffer* /*buffer*/) const
+	void bdTitleUtilities::get_server_time(i_server* server, byte_buffer_view* /*buffer*/) const
 	{
-		const auto time_result = new bdTimeStamp;
-		time_result->unix_time = uint32_t(time(nullptr));
+		bdTimeStamp time_result;
+		time_result.unix_time = uint32_t(time(nullptr));
 
 		auto reply = server->create_reply(this->get_sub_type());
-		reply->add(time_result);
-		reply->send();
+		reply.add(time_result);
+		reply.send();
 	}
 }
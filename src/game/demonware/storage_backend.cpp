@@ -0,0 +1,429 @@
+#include <std_include.hpp>
+#include "storage_backend.hpp"
+
+#include <utils/io.hpp>
+
+namespace demonware
+{
+	static const std::string log_path = "players2/user.log";
+
+	bool flat_file_backend::read(const std::string& name, std::string* data, uint32_t* modified_time)
+	{
+		const auto path = get_path(name);
+		if (!utils::io::read_file(path, data)) return false;
+
+		*modified_time = get_modified_time(path);
+		return true;
+	}
+
+	bool flat_file_backend::write(const std::string& name, const std::string& data)
+	{
+		return utils::io::write_file(get_path(name), data);
+	}
+
+	std::vector<std::string> flat_file_backend::list()
+	{
+		std::vector<std::string> names;
+
+		std::error_code error{};
+		std::filesystem::directory_iterator iterator("players2/user", error);
+		if (error) return names;
+
+		for (const auto end = std::filesystem::directory_iterator(); iterator != end; iterator.increment(error))
+		{
+			if (error) break;
+			if (iterator->is_regular_file(error)) names.push_back(iterator->path().filename().generic_string());
+		}
+
+		return names;
+	}
+
+	bool flat_file_backend::stat(const std::string& name, uint32_t* size, uint32_t* modified_time)
+	{
+		const auto path = get_path(name);
+
+		std::error_code error{};
+		const auto file_size = std::filesystem::file_size(path, error);
+		if (error) return false;
+
+		*size = uint32_t(file_size);
+		*modified_time = get_modified_time(path);
+		return true;
+	}
+
+	bool flat_file_backend::read_header(const std::string& name, const size_t size, std::string* data)
+	{
+		std::ifstream stream(get_path(name), std::ios::binary);
+		if (!stream.is_open()) return false;
+
+		data->resize(size);
+		stream.read(data->data(), std::streamsize(size));
+		data->resize(size_t(stream.gcount()));
+
+		return true;
+	}
+
+	std::string flat_file_backend::get_path(const std::string& name)
+	{
+		return "players2/user/" + name;
+	}
+
+	uint32_t flat_file_backend::get_modified_time(const std::string& path)
+	{
+		std::error_code error{};
+		const auto write_time = std::filesystem::last_write_time(path, error);
+		if (error) return 0;
+
+		const auto system_time = std::chrono::file_clock::to_sys(write_time);
+		return uint32_t(std::chrono::system_clock::to_time_t(system_time));
+	}
+
+	bool memory_backend::read(const std::string& name, std::string* data, uint32_t* modified_time)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->entries_.find(name);
+		if (entry == this->entries_.end()) return false;
+
+		*data = entry->second.data;
+		*modified_time = entry->second.modified_time;
+		return true;
+	}
+
+	bool memory_backend::write(const std::string& name, const std::string& data)
+	{
+		std::lock_guard _(this->mutex_);
+		this->entries_[name] = {data, uint32_t(time(nullptr))};
+		return true;
+	}
+
+	std::vector<std::string> memory_backend::list()
+	{
+		std::lock_guard _(this->mutex_);
+
+		std::vector<std::string> names;
+		names.reserve(this->entries_.size());
+
+		for (const auto& entry : this->entries_)
+		{
+			names.push_back(entry.first);
+		}
+
+		return names;
+	}
+
+	bool memory_backend::stat(const std::string& name, uint32_t* size, uint32_t* modified_time)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->entries_.find(name);
+		if (entry == this->entries_.end()) return false;
+
+		*size = uint32_t(entry->second.data.size());
+		*modified_time = entry->second.modified_time;
+		return true;
+	}
+
+	bool memory_backend::read_header(const std::string& name, const size_t size, std::string* data)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->entries_.find(name);
+		if (entry == this->entries_.end()) return false;
+
+		*data = entry->second.data.substr(0, size);
+		return true;
+	}
+
+	log_backend::log_backend()
+	{
+		this->open();
+		this->load_index();
+		this->compact();
+	}
+
+	bool log_backend::read(const std::string& name, std::string* data, uint32_t* modified_time)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->index_.find(name);
+		if (entry == this->index_.end()) return false;
+
+		data->resize(entry->second.size);
+
+		this->stream_.seekg(std::streamoff(entry->second.offset));
+		if (!this->stream_.read(data->data(), std::streamsize(data->size())))
+		{
+			this->stream_.clear();
+			return false;
+		}
+
+		*modified_time = entry->second.modified_time;
+		return true;
+	}
+
+	bool log_backend::write(const std::string& name, const std::string& data)
+	{
+		// The index couldn't be loaded back with it
+		if (name.size() > max_name_size) return false;
+
+		std::lock_guard _(this->mutex_);
+
+		const auto modified_time = uint32_t(time(nullptr));
+		const auto offset = this->log_size_;
+
+		this->stream_.seekp(std::streamoff(offset));
+		if (!write_record(this->stream_, name, data, modified_time) || !this->stream_.flush())
+		{
+			this->stream_.clear();
+			return false;
+		}
+
+		const auto record_size = sizeof(record_header) + name.size() + data.size();
+		this->log_size_ += record_size;
+
+		auto& entry = this->index_[name];
+		if (entry.offset)
+		{
+			this->outdated_size_ += sizeof(record_header) + name.size() + entry.size;
+		}
+
+		entry.offset = offset + sizeof(record_header) + name.size();
+		entry.size = uint32_t(data.size());
+		entry.modified_time = modified_time;
+
+		return true;
+	}
+
+	std::vector<std::string> log_backend::list()
+	{
+		std::lock_guard _(this->mutex_);
+
+		std::vector<std::string> names;
+		names.reserve(this->index_.size());
+
+		for (const auto& entry : this->index_)
+		{
+			names.push_back(entry.first);
+		}
+
+		return names;
+	}
+
+	bool log_backend::stat(const std::string& name, uint32_t* size, uint32_t* modified_time)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->index_.find(name);
+		if (entry == this->index_.end()) return false;
+
+		*size = entry->second.size;
+		*modified_time = entry->second.modified_time;
+		return true;
+	}
+
+	bool log_backend::read_header(const std::string& name, const size_t size, std::string* data)
+	{
+		std::lock_guard _(this->mutex_);
+
+		const auto entry = this->index_.find(name);
+		if (entry == this->index_.end()) return false;
+
+		data->resize(std::min(size, size_t(entry->second.size)));
+
+		this->stream_.seekg(std::streamoff(entry->second.offset));
+		if (!this->stream_.read(data->data(), std::streamsize(data->size())))
+		{
+			this->stream_.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	void log_backend::compact()
+	{
+		std::lock_guard _(this->mutex_);
+
+		// Not worth rewriting the log yet
+		if (this->outdated_size_ < 0x100000 || this->outdated_size_ * 2 < this->log_size_) return;
+
+		const auto temp_path = log_path + ".tmp";
+
+		std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+		if (!output.is_open()) return;
+
+		auto index = this->index_;
+		uint64_t size = 0;
+		std::string data;
+
+		for (auto& entry : index)
+		{
+			data.resize(entry.second.size);
+
+			this->stream_.seekg(std::streamoff(entry.second.offset));
+			if (!this->stream_.read(data.data(), std::streamsize(data.size())) ||
+				!write_record(output, entry.first, data, entry.second.modified_time))
+			{
+				this->stream_.clear();
+				output.close();
+				std::filesystem::remove(temp_path);
+				return;
+			}
+
+			entry.second.offset = size + sizeof(record_header) + entry.first.size();
+			size += sizeof(record_header) + entry.first.size() + data.size();
+		}
+
+		output.close();
+		this->stream_.close();
+
+		std::error_code error{};
+		std::filesystem::rename(temp_path, log_path, error);
+
+		this->open();
+
+		if (error)
+		{
+			// The old log is still intact
+			std::filesystem::remove(temp_path);
+			return;
+		}
+
+		printf("DW: Compacted user storage from %llu to %llu bytes\n", static_cast<unsigned long long>(this->log_size_),
+		       static_cast<unsigned long long>(size));
+
+		this->index_ = std::move(index);
+		this->log_size_ = size;
+		this->outdated_size_ = 0;
+	}
+
+	void log_backend::open()
+	{
+		if (!utils::io::file_exists(log_path))
+		{
+			utils::io::write_file(log_path, {});
+		}
+
+		this->stream_.open(log_path, std::ios::binary | std::ios::in | std::ios::out);
+	}
+
+	void log_backend::load_index()
+	{
+		std::lock_guard _(this->mutex_);
+
+		std::error_code error{};
+		const auto file_size = uint64_t(std::filesystem::file_size(log_path, error));
+		if (error) return;
+
+		uint64_t offset = 0;
+		auto damaged = false;
+		std::string name;
+
+		while (offset < file_size)
+		{
+			record_header header{};
+
+			this->stream_.seekg(std::streamoff(offset));
+			if (!this->stream_.read(reinterpret_cast<char*>(&header), sizeof(header))) break;
+
+			const auto data_offset = offset + sizeof(header) + header.name_size;
+			const auto end = data_offset + header.data_size;
+
+			// Damaged records are skipped up to the next one that looks intact, nothing after them is dropped
+			if (header.magic != record_magic || (damaged && end > file_size))
+			{
+				damaged = true;
+				offset = this->find_record(offset + 1, file_size);
+				continue;
+			}
+
+			// Make sure the record is actually there before allocating anything for it
+			if (end > file_size) break;
+
+			// Complete, but too large to be indexed
+			if (header.name_size > max_name_size)
+			{
+				offset = end;
+				continue;
+			}
+
+			name.resize(header.name_size);
+			if (!this->stream_.read(name.data(), std::streamsize(name.size()))) break;
+
+			auto& entry = this->index_[name];
+			if (entry.offset)
+			{
+				this->outdated_size_ += sizeof(header) + name.size() + entry.size;
+			}
+
+			entry.offset = data_offset;
+			entry.size = header.data_size;
+			entry.modified_time = header.modified_time;
+
+			offset = end;
+		}
+
+		this->stream_.clear();
+
+		if (damaged)
+		{
+			printf("DW: %s is damaged, records that couldn't be read are kept as they are\n", log_path.data());
+
+			this->log_size_ = file_size;
+			return;
+		}
+
+		this->log_size_ = offset;
+
+		// Anything after the last complete record is from an interrupted write
+		if (file_size > offset)
+		{
+			this->stream_.close();
+			std::filesystem::resize_file(log_path, offset, error);
+			this->open();
+		}
+	}
+
+	uint64_t log_backend::find_record(uint64_t offset, const uint64_t file_size)
+	{
+		std::string buffer(0x10000, '\0');
+		const std::string_view magic(reinterpret_cast<const char*>(&record_magic), sizeof(record_magic));
+
+		while (offset < file_size)
+		{
+			this->stream_.seekg(std::streamoff(offset));
+			this->stream_.read(buffer.data(), std::streamsize(buffer.size()));
+
+			// Reading up to the end sets the fail bit
+			const auto size = size_t(this->stream_.gcount());
+			this->stream_.clear();
+
+			if (size < magic.size()) break;
+
+			const auto position = std::string_view(buffer.data(), size).find(magic);
+			if (position != std::string_view::npos) return offset + position;
+
+			// The magic may span two reads
+			offset += size - (magic.size() - 1);
+		}
+
+		return file_size;
+	}
+
+	bool log_backend::write_record(std::ostream& stream, const std::string& name, const std::string_view data,
+	                               const uint32_t modified_time)
+	{
+		record_header header{};
+		header.magic = record_magic;
+		header.name_size = uint32_t(name.size());
+		header.data_size = uint32_t(data.size());
+		header.modified_time = modified_time;
+
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(name.data(), std::streamsize(name.size()));
+		stream.write(data.data(), std::streamsize(data.size()));
+
+		return bool(stream);
+	}
+}
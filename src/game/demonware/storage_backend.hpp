@@ -0,0 +1,116 @@
+#pragma once
+
+namespace demonware
+{
+	// Where user_storage keeps its files.
+	// Implementations have to be safe to use from several threads.
+	class storage_backend
+	{
+	public:
+		virtual ~storage_backend() = default;
+
+		virtual bool read(const std::string& name, std::string* data, uint32_t* modified_time) = 0;
+		virtual bool write(const std::string& name, const std::string& data) = 0;
+		virtual std::vector<std::string> list() = 0;
+
+		// Stored size and modification time, without loading the entry
+		virtual bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) = 0;
+
+		// Up to size leading bytes of the entry, enough to tell how it's encoded
+		virtual bool read_header(const std::string& name, size_t size, std::string* data) = 0;
+
+		// Reclaims space taken by outdated data, if the backend has any
+		virtual void compact()
+		{
+		}
+	};
+
+	// One file per entry in players2/user
+	class flat_file_backend final : public storage_backend
+	{
+	public:
+		bool read(const std::string& name, std::string* data, uint32_t* modified_time) override;
+		bool write(const std::string& name, const std::string& data) override;
+		std::vector<std::string> list() override;
+
+		bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) override;
+		bool read_header(const std::string& name, size_t size, std::string* data) override;
+
+	private:
+		static std::string get_path(const std::string& name);
+		static uint32_t get_modified_time(const std::string& path);
+	};
+
+	// Nothing leaves memory, for servers that must never touch the player's files
+	class memory_backend final : public storage_backend
+	{
+	public:
+		bool read(const std::string& name, std::string* data, uint32_t* modified_time) override;
+		bool write(const std::string& name, const std::string& data) override;
+		std::vector<std::string> list() override;
+
+		bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) override;
+		bool read_header(const std::string& name, size_t size, std::string* data) override;
+
+	private:
+		struct entry
+		{
+			std::string data;
+			uint32_t modified_time;
+		};
+
+		std::mutex mutex_;
+		std::unordered_map<std::string, entry> entries_;
+	};
+
+	// All entries are appended to players2/user.log, an in-memory index points to the latest
+	// version of each one. The log is opened once, so requests don't pay for opening files.
+	class log_backend final : public storage_backend
+	{
+	public:
+		log_backend();
+
+		bool read(const std::string& name, std::string* data, uint32_t* modified_time) override;
+		bool write(const std::string& name, const std::string& data) override;
+		std::vector<std::string> list() override;
+
+		bool stat(const std::string& name, uint32_t* size, uint32_t* modified_time) override;
+		bool read_header(const std::string& name, size_t size, std::string* data) override;
+
+		// Rewrites the log without outdated entries once they take up most of it
+		void compact() override;
+
+	private:
+		static constexpr uint32_t record_magic = 0x314C5744; // DWL1
+		static constexpr uint32_t max_name_size = 0x1000;
+
+		struct record_header
+		{
+			uint32_t magic;
+			uint32_t name_size;
+			uint32_t data_size;
+			uint32_t modified_time;
+		};
+
+		struct index_entry
+		{
+			uint64_t offset;
+			uint32_t size;
+			uint32_t modified_time;
+		};
+
+		std::mutex mutex_;
+		std::fstream stream_;
+		std::unordered_map<std::string, index_entry> index_;
+
+		uint64_t log_size_ = 0;
+		uint64_t outdated_size_ = 0;
+
+		void open();
+		void load_index();
+		uint64_t find_record(uint64_t offset, uint64_t file_size);
+
+		static bool write_record(std::ostream& stream, const std::string& name, std::string_view data,
+		                         uint32_t modified_time);
+	};
+}
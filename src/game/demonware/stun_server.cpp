@@ -3,6 +3,7 @@
 #include "module/dw.hpp"
 #include "utils/cryptography.hpp"
 #include "byte_buffer.hpp"
+#include "byte_buffer_view.hpp"
 
 namespace demonware
 {
@@ -52,7 +53,7 @@ namespace demonware
 	{
 		uint8_t type, version, padding;
 
-		byte_buffer buffer(std::string(buf, len));
+		byte_buffer_view buffer(std::string_view(buf, len));
 		buffer.set_use_data_types(false);
 		buffer.read_byte(&type);
 		buffer.read_byte(&version);
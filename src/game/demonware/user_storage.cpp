@@ -0,0 +1,525 @@
+#include <std_include.hpp>
+#include "user_storage.hpp"
+
+#include <utils/cryptography.hpp>
+#include <utils/flags.hpp>
+#include <utils/io.hpp>
+#include <utils/thread.hpp>
+
+namespace demonware
+{
+	user_storage::user_storage() : user_storage(create_backend())
+	{
+	}
+
+	user_storage::user_storage(std::unique_ptr<storage_backend> backend) : backend_(std::move(backend))
+	{
+		this->compress_ = utils::flags::has_flag("compressuserfiles");
+		this->load_dictionary();
+
+		this->writer_ = utils::thread::create_named_thread("DW Storage", [this]()
+		{
+			this->run_writer();
+		});
+	}
+
+	user_storage::~user_storage()
+	{
+		{
+			std::lock_guard _(this->mutex_);
+			this->stopping_ = true;
+		}
+
+		// The writer drains the queue before exiting
+		this->write_condition_.notify_all();
+		if (this->writer_.joinable())
+		{
+			this->writer_.join();
+		}
+
+		this->backend_->compact();
+	}
+
+	std::shared_ptr<const std::string> user_storage::read(const std::string& name, bool* unreadable)
+	{
+		if (unreadable) *unreadable = false;
+
+		{
+			std::lock_guard _(this->mutex_);
+
+			const auto entry = this->pending_.find(name);
+			if (entry != this->pending_.end())
+			{
+				return entry->second;
+			}
+
+			auto cached = this->find_cached(name);
+			if (cached)
+			{
+				return cached;
+			}
+
+			const auto info = this->index_.find(name);
+			if (info != this->index_.end() && !info->second.exists)
+			{
+				return {};
+			}
+		}
+
+		std::string data;
+		uint32_t modified_time = 0;
+		const auto exists = this->backend_->read(name, &data, &modified_time);
+		const auto decoded = exists && this->decode(&data);
+
+		auto buffer = std::make_shared<const std::string>(std::move(data));
+
+		std::lock_guard _(this->mutex_);
+
+		// Data written while reading is newer than what's on the disk
+		const auto entry = this->pending_.find(name);
+		if (entry != this->pending_.end())
+		{
+			return entry->second;
+		}
+
+		// Neither cached nor indexed, the file may become readable once its dictionary is back
+		if (exists && !decoded)
+		{
+			printf("DW: User file %s can't be decoded\n", name.data());
+			if (unreadable) *unreadable = true;
+			return {};
+		}
+
+		this->update_index(name, exists, buffer->size(), modified_time);
+		if (!exists) return {};
+
+		this->cache(name, buffer);
+		return buffer;
+	}
+
+	void user_storage::write(const std::string& name, std::string data)
+	{
+		auto buffer = std::make_shared<const std::string>(std::move(data));
+
+		{
+			std::lock_guard _(this->mutex_);
+
+			this->update_index(name, true, buffer->size(), uint32_t(time(nullptr)));
+			this->cache(name, buffer);
+			if (this->names_loaded_) this->names_.insert(name);
+
+			auto& entry = this->pending_[name];
+			if (!entry) this->queue_.push_back(name);
+
+			entry = std::move(buffer);
+		}
+
+		this->write_condition_.notify_one();
+	}
+
+	bool user_storage::get_info(const std::string& name, file_info* info)
+	{
+		{
+			std::lock_guard _(this->mutex_);
+
+			const auto entry = this->index_.find(name);
+			if (entry != this->index_.end())
+			{
+				*info = entry->second.info;
+				return entry->second.exists;
+			}
+		}
+
+		// Only the header is needed, compressed files store their size in it
+		uint32_t size = 0, modified_time = 0;
+		std::string header;
+
+		const auto exists = this->backend_->stat(name, &size, &modified_time);
+		if (exists && this->backend_->read_header(name, sizeof(compressed_header), &header))
+		{
+			size = get_raw_size(header, size);
+		}
+
+		std::lock_guard _(this->mutex_);
+
+		// A write while checking the disk already indexed newer data
+		if (!this->pending_.contains(name))
+		{
+			this->update_index(name, exists, size, modified_time);
+		}
+
+		const auto& entry = this->index_[name];
+
+		*info = entry.info;
+		return entry.exists;
+	}
+
+	std::vector<std::string> user_storage::list(const size_t offset, const size_t count)
+	{
+		std::vector<std::string> names;
+
+		std::unique_lock lock(this->mutex_);
+
+		if (!this->names_loaded_)
+		{
+			lock.unlock();
+			auto stored_names = this->backend_->list();
+			lock.lock();
+
+			if (!this->names_loaded_)
+			{
+				// Queued files may not have reached the backend yet
+				this->names_.insert(stored_names.begin(), stored_names.end());
+				for (const auto& entry : this->pending_)
+				{
+					this->names_.insert(entry.first);
+				}
+
+				this->names_loaded_ = true;
+			}
+		}
+
+		if (offset >= this->names_.size()) return names;
+
+		auto name = std::next(this->names_.begin(), ptrdiff_t(offset));
+		for (; name != this->names_.end() && names.size() < count; ++name)
+		{
+			names.push_back(*name);
+		}
+
+		return names;
+	}
+
+	void user_storage::flush()
+	{
+		std::unique_lock lock(this->mutex_);
+		this->flush_condition_.wait(lock, [this]()
+		{
+			return this->queue_.empty() && !this->writes_in_flight_;
+		});
+	}
+
+	void user_storage::run_writer()
+	{
+		// Reads the existing files, so it's kept out of the constructor. Queued writes wait for it.
+		if (this->train_dictionary_)
+		{
+			this->train_dictionary();
+		}
+
+		std::unique_lock lock(this->mutex_);
+
+		while (true)
+		{
+			this->write_condition_.wait(lock, [this]()
+			{
+				return this->stopping_ || !this->queue_.empty();
+			});
+
+			if (this->queue_.empty())
+			{
+				if (this->stopping_) break;
+				continue;
+			}
+
+			const auto name = std::move(this->queue_.front());
+			this->queue_.pop_front();
+
+			const auto data = this->pending_[name];
+			++this->writes_in_flight_;
+
+			lock.unlock();
+
+			std::string encoded;
+			const auto written = this->backend_->write(name, this->encode(*data, &encoded) ? encoded : *data);
+
+			lock.lock();
+
+			--this->writes_in_flight_;
+
+			const auto entry = this->pending_.find(name);
+
+			if (!written)
+			{
+				printf("DW: Failed to store user file %s\n", name.data());
+
+				// The data stays pending, so reads still get it instead of the outdated copy on the disk
+				if (!this->stopping_)
+				{
+					this->queue_.push_back(name);
+					this->retry_delay_ = std::clamp(this->retry_delay_ * 2, min_retry_delay, max_retry_delay);
+
+					this->write_condition_.wait_for(lock, this->retry_delay_, [this]()
+					{
+						return this->stopping_;
+					});
+
+					continue;
+				}
+
+				if (entry->second == data)
+				{
+					printf("DW: Giving up on user file %s\n", name.data());
+				}
+			}
+			else
+			{
+				this->retry_delay_ = {};
+			}
+
+			// A rewrite while the file was on its way to the disk
+			// didn't queue it again, so the newer data still has to go out
+			if (entry->second == data)
+			{
+				this->pending_.erase(entry);
+			}
+			else
+			{
+				this->queue_.push_back(name);
+			}
+
+			if (this->queue_.empty() && !this->writes_in_flight_)
+			{
+				this->flush_condition_.notify_all();
+			}
+		}
+	}
+
+	void user_storage::load_dictionary()
+	{
+		std::string data;
+		if (!utils::io::read_file(dictionary_path, &data))
+		{
+			this->train_dictionary_ = this->compress_;
+			return;
+		}
+
+		this->set_dictionary(data);
+	}
+
+	void user_storage::train_dictionary()
+	{
+		// Train one from the existing profiles, they all share the same structure
+		std::vector<std::string> samples;
+
+		for (const auto& name : this->backend_->list())
+		{
+			// Files compressed with the missing dictionary can only ever be read with that one,
+			// a new dictionary gets a different id and would leave them unreadable for good
+			std::string header_data;
+			compressed_header header{};
+			if (this->backend_->read_header(name, sizeof(header), &header_data)
+				&& header_data.size() >= sizeof(header))
+			{
+				std::memcpy(&header, header_data.data(), sizeof(header));
+				if (header.magic == compressed_magic && header.dictionary_id)
+				{
+					printf("DW: %s is missing but user files depend on it, not training a new one\n",
+					       dictionary_path);
+					return;
+				}
+			}
+
+			// Only the headers of the remaining files are needed
+			if (samples.size() >= max_dictionary_samples) continue;
+
+			std::string sample;
+			uint32_t modified_time;
+			if (this->backend_->read(name, &sample, &modified_time) && this->decode(&sample) && !sample.empty())
+			{
+				sample.resize(std::min(sample.size(), size_t(0x10000)));
+				samples.push_back(std::move(sample));
+			}
+		}
+
+		if (samples.size() < 32) return;
+
+		const auto data = utils::compression::zstd::train_dictionary(samples, 0x4000);
+		if (data.empty()) return;
+
+		utils::io::write_file(dictionary_path, data);
+		this->set_dictionary(data);
+	}
+
+	void user_storage::set_dictionary(const std::string& data)
+	{
+		auto dictionary = std::make_shared<const utils::compression::zstd::dictionary>(data, compression_level);
+		if (!dictionary->is_valid() || !dictionary->get_id()) return;
+
+		std::lock_guard _(this->mutex_);
+		this->dictionary_ = std::move(dictionary);
+	}
+
+	std::shared_ptr<const utils::compression::zstd::dictionary> user_storage::get_dictionary()
+	{
+		std::lock_guard _(this->mutex_);
+		return this->dictionary_;
+	}
+
+	bool user_storage::encode(const std::string& data, std::string* output) const
+	{
+		compressed_header header{};
+		header.raw_size = uint32_t(data.size());
+
+		if (this->compress_)
+		{
+			const auto compressed = utils::compression::zstd::compress(data, compression_level,
+			                                                           this->dictionary_.get());
+
+			if (!compressed.empty() && compressed.size() + sizeof(header) < data.size())
+			{
+				header.magic = compressed_magic;
+				header.dictionary_id = this->dictionary_ ? this->dictionary_->get_id() : 0;
+
+				output->reserve(sizeof(header) + compressed.size());
+				output->append(reinterpret_cast<const char*>(&header), sizeof(header));
+				output->append(compressed);
+				return true;
+			}
+		}
+		else
+		{
+			// Plain files stay plain, unless they start like a header and would be misread
+			uint32_t magic{};
+			if (data.size() >= sizeof(magic)) std::memcpy(&magic, data.data(), sizeof(magic));
+			if (magic != compressed_magic && magic != raw_magic) return false;
+		}
+
+		// Data that doesn't get any smaller is stored as it is, behind a header saying so
+		header.magic = raw_magic;
+
+		output->reserve(sizeof(header) + data.size());
+		output->append(reinterpret_cast<const char*>(&header), sizeof(header));
+		output->append(data);
+		return true;
+	}
+
+	bool user_storage::decode(std::string* data)
+	{
+		compressed_header header{};
+		if (data->size() < sizeof(header)) return true;
+
+		std::memcpy(&header, data->data(), sizeof(header));
+
+		if (header.magic == raw_magic)
+		{
+			if (header.raw_size != data->size() - sizeof(header)) return false;
+
+			data->erase(0, sizeof(header));
+			return true;
+		}
+
+		if (header.magic != compressed_magic) return true;
+
+		// The output buffer is sized from the header, it must not be trusted blindly
+		if (header.raw_size > max_file_size) return false;
+
+		std::shared_ptr<const utils::compression::zstd::dictionary> dictionary;
+		if (header.dictionary_id)
+		{
+			dictionary = this->get_dictionary();
+			if (!dictionary || dictionary->get_id() != header.dictionary_id)
+			{
+				printf("DW: User file needs a missing storage dictionary (%X)\n", header.dictionary_id);
+				return false;
+			}
+		}
+
+		std::string result;
+		const auto compressed = std::string_view(*data).substr(sizeof(header));
+		if (!utils::compression::zstd::decompress(compressed, header.raw_size, &result, dictionary.get()))
+		{
+			return false;
+		}
+
+		*data = std::move(result);
+		return true;
+	}
+
+	uint32_t user_storage::get_raw_size(const std::string_view data, const uint32_t stored_size)
+	{
+		compressed_header header{};
+		if (data.size() < sizeof(header)) return stored_size;
+
+		std::memcpy(&header, data.data(), sizeof(header));
+		if (header.magic != compressed_magic && header.magic != raw_magic) return stored_size;
+
+		return header.raw_size;
+	}
+
+	void user_storage::cache(const std::string& name, std::shared_ptr<const std::string> data)
+	{
+		const auto entry = this->cache_entries_.find(name);
+		if (entry != this->cache_entries_.end())
+		{
+			this->cache_size_ -= entry->second->second->size();
+			this->cache_.erase(entry->second);
+			this->cache_entries_.erase(entry);
+		}
+
+		if (data->size() > max_cached_file_size) return;
+
+		this->cache_size_ += data->size();
+		this->cache_.emplace_front(name, std::move(data));
+		this->cache_entries_[name] = this->cache_.begin();
+
+		while (this->cache_size_ > max_cache_size)
+		{
+			auto& last = this->cache_.back();
+			this->cache_size_ -= last.second->size();
+			this->cache_entries_.erase(last.first);
+			this->cache_.pop_back();
+		}
+	}
+
+	std::shared_ptr<const std::string> user_storage::find_cached(const std::string& name)
+	{
+		const auto entry = this->cache_entries_.find(name);
+		if (entry == this->cache_entries_.end()) return {};
+
+		this->cache_.splice(this->cache_.begin(), this->cache_, entry->second);
+		return entry->second->second;
+	}
+
+	void user_storage::update_index(const std::string& name, const bool exists, const size_t size,
+	                                const uint32_t modified_time)
+	{
+		if (!exists && this->missing_entries_ >= max_missing_entries)
+		{
+			std::erase_if(this->index_, [](const auto& entry)
+			{
+				return !entry.second.exists;
+			});
+
+			this->missing_entries_ = 0;
+		}
+
+		auto [entry_iterator, inserted] = this->index_.try_emplace(name);
+		auto& entry = entry_iterator->second;
+
+		if (!inserted && !entry.exists) --this->missing_entries_;
+		if (!exists) ++this->missing_entries_;
+
+		// The id is a hash of the name, it only has to be computed once
+		if (!entry.info.id) entry.info.id = get_file_id(name);
+
+		entry.exists = exists;
+		entry.info.size = uint32_t(size);
+		entry.info.modified_time = modified_time;
+	}
+
+	std::unique_ptr<storage_backend> user_storage::create_backend()
+	{
+		if (utils::flags::has_flag("userstoragelog"))
+		{
+			return std::make_unique<log_backend>();
+		}
+
+		return std::make_unique<flat_file_backend>();
+	}
+
+	uint64_t user_storage::get_file_id(const std::string& name)
+	{
+		return *reinterpret_cast<const uint64_t*>(utils::cryptography::sha1::compute(name).data());
+	}
+}
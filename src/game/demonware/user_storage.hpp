@@ -0,0 +1,136 @@
+#pragma once
+#include <utils/compression.hpp>
+
+#include "storage_backend.hpp"
+
+namespace demonware
+{
+	// Write-behind store for user files.
+	// Writes are queued and flushed by a background thread,
+	// reads of files that are still queued are served from memory.
+	// Recently used files and the metadata of every file seen so far
+	// are cached, so repeated loads and listings stay off the disk.
+	// With -compressuserfiles new files are stored zstd compressed,
+	// reading works for both formats. -userstoragelog keeps all files
+	// in a single append-only log instead of one file each.
+	class user_storage final
+	{
+	public:
+		struct file_info
+		{
+			uint64_t id;
+			uint32_t size;
+			uint32_t modified_time;
+		};
+
+		user_storage();
+		explicit user_storage(std::unique_ptr<storage_backend> backend);
+		~user_storage();
+
+		user_storage(user_storage&&) = delete;
+		user_storage(const user_storage&) = delete;
+		user_storage& operator=(const user_storage&) = delete;
+
+		// Returned data is shared with the cache, a null pointer means the file doesn't exist.
+		// Files that exist but can't be decoded set unreadable, they must not be treated as missing.
+		std::shared_ptr<const std::string> read(const std::string& name, bool* unreadable = nullptr);
+		void write(const std::string& name, std::string data);
+
+		bool get_info(const std::string& name, file_info* info);
+
+		// Pages through all file names in sorted order
+		std::vector<std::string> list(size_t offset, size_t count);
+
+		// Blocks until every queued write reached the disk
+		void flush();
+
+		static uint64_t get_file_id(const std::string& name);
+
+		// The backend picked by the command line
+		static std::unique_ptr<storage_backend> create_backend();
+
+	private:
+		static constexpr size_t max_cache_size = 32 * 1024 * 1024;
+		static constexpr size_t max_cached_file_size = max_cache_size / 8;
+
+		// Clients can ask for any name, so remembered misses are dropped once there are too many
+		static constexpr size_t max_missing_entries = 4096;
+
+		// Files arrive in a single frame, a header claiming more than that is corrupt
+		static constexpr size_t max_file_size = 0x1000000;
+
+		static constexpr uint32_t compressed_magic = 0x315A5744; // DWZ1
+		static constexpr uint32_t raw_magic = 0x31525744; // DWR1
+		static constexpr int compression_level = 3;
+
+		static constexpr auto dictionary_path = "players2/user.dict";
+		static constexpr size_t max_dictionary_samples = 2048;
+
+		// Failed writes are retried with a growing delay, a full disk doesn't recover right away
+		static constexpr std::chrono::milliseconds min_retry_delay{100};
+		static constexpr std::chrono::milliseconds max_retry_delay{30000};
+
+		struct compressed_header
+		{
+			uint32_t magic;
+			uint32_t raw_size;
+			uint32_t dictionary_id;
+		};
+
+		using cache_list = std::list<std::pair<std::string, std::shared_ptr<const std::string>>>;
+
+		struct index_entry
+		{
+			bool exists;
+			file_info info;
+		};
+
+		std::mutex mutex_;
+		std::condition_variable write_condition_;
+		std::condition_variable flush_condition_;
+
+		// Repeated writes to a queued file only replace its data
+		std::unordered_map<std::string, std::shared_ptr<const std::string>> pending_;
+		std::deque<std::string> queue_;
+		size_t writes_in_flight_ = 0;
+		std::chrono::milliseconds retry_delay_{};
+
+		// Most recently used files are at the front
+		cache_list cache_;
+		std::unordered_map<std::string, cache_list::iterator> cache_entries_;
+		size_t cache_size_ = 0;
+
+		std::unordered_map<std::string, index_entry> index_;
+		size_t missing_entries_ = 0;
+
+		// Every stored name, loaded from the backend on the first listing
+		std::set<std::string> names_;
+		bool names_loaded_ = false;
+
+		std::unique_ptr<storage_backend> backend_;
+
+		bool compress_ = false;
+		bool train_dictionary_ = false;
+
+		// Only the writer replaces it, everyone else takes a copy under the mutex
+		std::shared_ptr<const utils::compression::zstd::dictionary> dictionary_;
+
+		bool stopping_ = false;
+		std::thread writer_;
+
+		void run_writer();
+
+		void load_dictionary();
+		void train_dictionary();
+		void set_dictionary(const std::string& data);
+		std::shared_ptr<const utils::compression::zstd::dictionary> get_dictionary();
+
+		bool encode(const std::string& data, std::string* output) const;
+		bool decode(std::string* data);
+		static uint32_t get_raw_size(std::string_view data, uint32_t stored_size);
+
+		void cache(const std::string& name, std::shared_ptr<const std::string> data);
+		std::shared_ptr<const std::string> find_cached(const std::string& name);
+		void update_index(const std::string& name, bool exists, size_t size, uint32_t modified_time);
+	};
+}
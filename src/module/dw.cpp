@@ -2,6 +2,7 @@
 #include <utils/hook.hpp>
 #include <utils/nt.hpp>
 #include <utils/cryptography.hpp>
+#include <utils/flags.hpp>
 
 #include "game/demonware/services/bdLSGHello.hpp"       // 7
 #include "game/demonware/services/bdStorage.hpp"        // 10
@@ -10,8 +11,10 @@
 #include "game/demonware/services/bdDML.hpp"            // 27
 #include "game/demonware/services/bdDediRSAAuth.hpp"    // 26
 #include "game/demonware/services/bdSteamAuth.hpp"      // 28
+#include "game/demonware/replay.hpp"
 
 #include "game/game.hpp"
+#include "command.hpp"
 #include "dw.hpp"
 
 namespace demonware
@@ -56,13 +59,20 @@ namespace demonware
 			{
 				const auto blocking = dw::is_blocking_socket(s, TCP_BLOCKING);
 
-				int result;
-				do
+				auto result = server->recv(buf, len);
+				while (blocking && result < 0)
 				{
-					result = server->recv(buf, len);
-					if (blocking && result < 0) std::this_thread::sleep_for(1ms);
+					// Wait in slices so a socket closed by another thread doesn't block forever
+					if (server->wait_for_reply(100ms))
+					{
+						result = server->recv(buf, len);
+					}
+					else if (!dw::find_server_by_socket(s))
+					{
+						WSASetLastError(WSAENOTSOCK);
+						return SOCKET_ERROR;
+					}
 				}
-				while (blocking && result < 0);
 
 				if (!blocking && result < 0)
 				{
@@ -157,27 +167,36 @@ namespace demonware
 
 namespace demonware
 {
-	bool dw::terminate_;
-	std::thread dw::message_thread_;
-	std::recursive_mutex dw::server_mutex_;
-	std::map<SOCKET, bool> dw::blocking_sockets_;
-	std::map<SOCKET, std::shared_ptr<service_server>> dw::socket_links_;
-	std::map<unsigned long, std::shared_ptr<service_server>> dw::servers_;
-	std::map<unsigned long, std::shared_ptr<stun_server>> dw::stun_servers_;
-	std::map<SOCKET, std::queue<std::pair<std::string, std::string>>> dw::datagram_packets_;
+	std::shared_mutex dw::routing_mutex_;
+	std::shared_mutex dw::datagram_mutex_;
+	std::shared_mutex dw::blocking_mutex_;
+	std::condition_variable_any dw::datagram_condition_;
+	std::unordered_map<SOCKET, bool> dw::blocking_sockets_;
+	std::unordered_map<SOCKET, std::shared_ptr<service_server>> dw::socket_links_;
+	std::unordered_map<unsigned long, std::shared_ptr<service_server>> dw::servers_;
+	std::unordered_map<unsigned long, std::shared_ptr<stun_server>> dw::stun_servers_;
+	std::unordered_map<SOCKET, std::queue<std::pair<std::string, std::string>>> dw::datagram_packets_;
+	utils::concurrency::filter<4096> dw::dw_sockets_;
+	utils::concurrency::filter<64> dw::stun_addresses_;
 
 	uint8_t dw::encryption_key_[24];
 	uint8_t dw::decryption_key_[24];
 
+	std::mutex dw::cipher_mutex_;
+	std::shared_ptr<const utils::cryptography::des3::context> dw::encryption_cipher_;
+	std::shared_ptr<const utils::cryptography::des3::context> dw::decryption_cipher_;
+
+	std::mutex dw::iv_mutex_;
+	std::pair<uint32_t, std::string> dw::iv_cache_[16];
+
 	std::shared_ptr<service_server> dw::find_server_by_name(const std::string& name)
 	{
-		std::lock_guard _(server_mutex_);
 		return find_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
 	}
 
 	std::shared_ptr<service_server> dw::find_server_by_address(const unsigned long address)
 	{
-		std::lock_guard _(server_mutex_);
+		std::shared_lock _(routing_mutex_);
 
 		const auto server = servers_.find(address);
 		if (server != servers_.end())
@@ -190,13 +209,14 @@ namespace demonware
 
 	std::shared_ptr<stun_server> dw::find_stun_server_by_name(const std::string& name)
 	{
-		std::lock_guard _(server_mutex_);
 		return find_stun_server_by_address(utils::cryptography::jenkins_one_at_a_time::compute(name));
 	}
 
 	std::shared_ptr<stun_server> dw::find_stun_server_by_address(const unsigned long address)
 	{
-		std::lock_guard _(server_mutex_);
+		if (!stun_addresses_.may_contain(address)) return {};
+
+		std::shared_lock _(routing_mutex_);
 
 		const auto server = stun_servers_.find(address);
 		if (server != stun_servers_.end())
@@ -209,7 +229,9 @@ namespace demonware
 
 	std::shared_ptr<service_server> dw::find_server_by_socket(const SOCKET s)
 	{
-		std::lock_guard _(server_mutex_);
+		if (!dw_sockets_.may_contain(s)) return {};
+
+		std::shared_lock _(routing_mutex_);
 
 		const auto server = socket_links_.find(s);
 		if (server != socket_links_.end())
@@ -222,51 +244,103 @@ namespace demonware
 
 	bool dw::link_socket(const SOCKET s, const unsigned long address)
 	{
-		std::lock_guard _(server_mutex_);
+		std::unique_lock _(routing_mutex_);
 
-		const auto server = find_server_by_address(address);
-		if (!server) return false;
+		const auto server = servers_.find(address);
+		if (server == servers_.end()) return false;
+
+		if (socket_links_.insert_or_assign(s, server->second).second)
+		{
+			dw_sockets_.add(s);
+		}
 
-		socket_links_[s] = server;
 		return true;
 	}
 
 	void dw::unlink_socket(const SOCKET sock)
 	{
-		std::lock_guard _(server_mutex_);
+		if (!dw_sockets_.may_contain(sock)) return;
+
+		{
+			std::unique_lock _(routing_mutex_);
+			if (socket_links_.erase(sock)) dw_sockets_.remove(sock);
+		}
 
-		const auto server = socket_links_.find(sock);
-		if (server != socket_links_.end())
 		{
-			socket_links_.erase(server);
+			std::unique_lock _(datagram_mutex_);
+			if (!datagram_packets_.erase(sock)) return;
+			dw_sockets_.remove(sock);
 		}
 
-		const auto dgram_packets = datagram_packets_.find(sock);
-		if (dgram_packets != datagram_packets_.end())
+		datagram_condition_.notify_all();
+	}
+
+	// The game's own socket still carries its SO_RCVTIMEO, zero means it waits forever
+	static std::chrono::milliseconds get_receive_timeout(const SOCKET s)
+	{
+		DWORD timeout = 0;
+		int length = sizeof(timeout);
+		if (getsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char*>(&timeout), &length) == SOCKET_ERROR)
 		{
-			datagram_packets_.erase(dgram_packets);
+			return {};
 		}
+
+		return std::chrono::milliseconds(timeout);
 	}
 
 	int dw::recv_datagam_packet(const SOCKET s, char* buf, const int len, sockaddr* from, int* fromlen)
 	{
-		std::unique_lock lock(server_mutex_);
+		if (!dw_sockets_.may_contain(s)) return 0;
+
+		{
+			std::shared_lock _(datagram_mutex_);
+			if (datagram_packets_.find(s) == datagram_packets_.end()) return 0;
+		}
+
+		const auto blocking = is_blocking_socket(s, UDP_BLOCKING);
+		const auto timeout = blocking ? get_receive_timeout(s) : std::chrono::milliseconds{};
+
+		std::unique_lock lock(datagram_mutex_);
 
 		auto queue = datagram_packets_.find(s);
 		if (queue != datagram_packets_.end())
 		{
-			const auto blocking = is_blocking_socket(s, UDP_BLOCKING);
-
-			lock.unlock();
-			while (blocking && queue->second.empty())
+			if (blocking)
 			{
-				std::this_thread::sleep_for(1ms);
+				const auto deadline = timeout.count()
+					                      ? std::chrono::steady_clock::now() + timeout
+					                      : std::chrono::steady_clock::time_point::max();
+
+				const auto is_ready = [s]()
+				{
+					const auto entry = datagram_packets_.find(s);
+					return entry == datagram_packets_.end() || !entry->second.empty();
+				};
+
+				while (!is_ready())
+				{
+					const auto now = std::chrono::steady_clock::now();
+					if (now >= deadline)
+					{
+						WSASetLastError(WSAETIMEDOUT);
+						return -1;
+					}
+
+					// Wait in slices like the TCP path, so a missed wakeup can't block forever
+					datagram_condition_.wait_for(lock, std::min<std::chrono::steady_clock::duration>(100ms, deadline - now));
+				}
+
+				queue = datagram_packets_.find(s);
+				if (queue == datagram_packets_.end())
+				{
+					WSASetLastError(WSAENOTSOCK);
+					return -1;
+				}
 			}
-			lock.lock();
 
 			if (!queue->second.empty())
 			{
-				auto packet = queue->second.front();
+				const auto packet = std::move(queue->second.front());
 				queue->second.pop();
 
 				*fromlen = INT(packet.first.size());
@@ -287,17 +361,26 @@ namespace demonware
 
 	void dw::send_datagram_packet(const SOCKET s, const std::string& data, const sockaddr* to, const int tolen)
 	{
-		std::lock_guard _(server_mutex_);
-		datagram_packets_[s].push({std::string(LPSTR(to), tolen), data});
+		{
+			std::unique_lock _(datagram_mutex_);
+
+			auto [queue, inserted] = datagram_packets_.try_emplace(s);
+			if (inserted) dw_sockets_.add(s);
+
+			queue->second.push({std::string(LPSTR(to), tolen), data});
+		}
+
+		datagram_condition_.notify_all();
 	}
 
 	bool dw::is_blocking_socket(const SOCKET s, const bool def)
 	{
-		std::lock_guard _(server_mutex_);
+		std::shared_lock _(blocking_mutex_);
 
-		if (blocking_sockets_.find(s) != blocking_sockets_.end())
+		const auto entry = blocking_sockets_.find(s);
+		if (entry != blocking_sockets_.end())
 		{
-			return blocking_sockets_[s];
+			return entry->second;
 		}
 
 		return def;
@@ -305,85 +388,123 @@ namespace demonware
 
 	void dw::remove_blocking_socket(const SOCKET s)
 	{
-		std::lock_guard _(server_mutex_);
-
-		const auto entry = blocking_sockets_.find(s);
-		if (entry != blocking_sockets_.end())
-		{
-			blocking_sockets_.erase(entry);
-		}
+		std::unique_lock _(blocking_mutex_);
+		blocking_sockets_.erase(s);
 	}
 
 	void dw::set_blocking_socket(const SOCKET s, const bool blocking)
 	{
-		std::lock_guard _(server_mutex_);
+		std::unique_lock _(blocking_mutex_);
 		blocking_sockets_[s] = blocking;
 	}
 
-	uint8_t* dw::get_key(const bool encrypt)
+	std::string dw::get_key(const bool encrypt)
 	{
-		return encrypt ? encryption_key_ : decryption_key_;
+		// Copied under the lock, set_key may run on the server thread at the same time
+		std::lock_guard _(cipher_mutex_);
+		return std::string(reinterpret_cast<char*>(encrypt ? encryption_key_ : decryption_key_), sizeof encryption_key_);
 	}
 
 	void dw::set_key(const bool encrypt, uint8_t* key)
 	{
 		static_assert(sizeof encryption_key_ == sizeof decryption_key_);
+
+		auto cipher = std::make_shared<const utils::cryptography::des3::context>(
+			std::string(reinterpret_cast<char*>(key), sizeof encryption_key_));
+
+		std::lock_guard _(cipher_mutex_);
 		std::memcpy(encrypt ? encryption_key_ : decryption_key_, key, sizeof encryption_key_);
+		(encrypt ? encryption_cipher_ : decryption_cipher_) = std::move(cipher);
 	}
 
-	void dw::server_thread()
+	std::shared_ptr<const utils::cryptography::des3::context> dw::get_cipher(const bool encrypt)
 	{
-		terminate_ = false;
-		while (!terminate_)
+		std::lock_guard _(cipher_mutex_);
+
+		auto& cipher = encrypt ? encryption_cipher_ : decryption_cipher_;
+		if (!cipher)
 		{
-			std::unique_lock lock(server_mutex_);
+			cipher = std::make_shared<const utils::cryptography::des3::context>(
+				std::string(reinterpret_cast<char*>(encrypt ? encryption_key_ : decryption_key_), sizeof encryption_key_));
+		}
 
-			for (auto& server : servers_)
-			{
-				server.second->run_frame();
-			}
+		return cipher;
+	}
+
+	std::string dw::get_iv(const uint32_t seed)
+	{
+		std::lock_guard _(iv_mutex_);
 
-			lock.unlock();
+		// Only the first block of the hash is used, which also keeps the result in SSO storage
+		auto& entry = iv_cache_[seed % ARRAYSIZE(iv_cache_)];
+		if (entry.second.empty() || entry.first != seed)
+		{
+			entry.first = seed;
+			entry.second = utils::cryptography::tiger::compute(reinterpret_cast<const uint8_t*>(&seed), sizeof seed);
+			entry.second.resize(8);
+		}
+
+		return entry.second;
+	}
 
-			std::this_thread::sleep_for(50ms);
+	void dw::print_metrics()
+	{
+		std::shared_lock _(routing_mutex_);
+
+		for (const auto& server : servers_)
+		{
+			server.second->print_metrics();
 		}
 	}
 
 	void dw::pre_destroy()
 	{
-		std::lock_guard _(server_mutex_);
+		{
+			std::shared_lock _(routing_mutex_);
+
+			for (auto& server : servers_)
+			{
+				server.second->stop();
+			}
+		}
+
+		print_metrics();
 
-		terminate_ = true;
-		if (message_thread_.joinable())
 		{
-			message_thread_.join();
+			std::unique_lock _(routing_mutex_);
+
+			servers_.clear();
+			stun_servers_.clear();
+			socket_links_.clear();
 		}
 
-		servers_.clear();
-		stun_servers_.clear();
-		socket_links_.clear();
-		blocking_sockets_.clear();
+		{
+			std::unique_lock _(blocking_mutex_);
+			blocking_sockets_.clear();
+		}
+
+		std::unique_lock _(datagram_mutex_);
 		datagram_packets_.clear();
-	}
 
-	dw::dw()
-	{
-		register_stun_server("mw3-stun.us.demonware.net");
-		register_stun_server("mw3-stun.eu.demonware.net");
-		register_stun_server("stun.jp.demonware.net");
-		register_stun_server("stun.au.demonware.net");
-		register_stun_server("stun.eu.demonware.net");
-		register_stun_server("stun.us.demonware.net");
+		dw_sockets_.clear();
+		stun_addresses_.clear();
+	}
 
-		auto lsg_server = register_server("mw3-pc-lobby.prod.demonware.net");
-		auto auth_server = register_server("mw3-pc-auth.prod.demonware.net");
+	static const std::string lobby_server_name = "mw3-pc-lobby.prod.demonware.net";
+	static const std::string auth_server_name = "mw3-pc-auth.prod.demonware.net";
 
+	// Offline servers keep user files in memory, so replayed requests can't touch the player's storage
+	static void register_services(service_server* lsg_server, service_server* auth_server, const bool offline)
+	{
 		auth_server->register_service<bdDediAuth>();
 		auth_server->register_service<bdSteamAuth>();
 		auth_server->register_service<bdDediRSAAuth>();
 
 		lsg_server->register_service<bdLSGHello>();
-		lsg_server->register_service<bdStorage>();
+
+		if (offline) lsg_server->register_service<bdStorage>(std::make_unique<memory_backend>());
+		else lsg_server->register_service<bdStorage>();
+
 		lsg_server->register_service<bdTitleUtilities>();
 		lsg_server->register_service<bdDML>();
 		/*lsg_server->register_service<bdMatchMaking>();
@@ -393,9 +514,65 @@ namespace demonware
 		lsg_server->register_service<bdRelayService>();*/
 	}
 
+	dw::dw()
+	{
+		register_stun_server("mw3-stun.us.demonware.net");
+		register_stun_server("mw3-stun.eu.demonware.net");
+		register_stun_server("stun.jp.demonware.net");
+		register_stun_server("stun.au.demonware.net");
+		register_stun_server("stun.eu.demonware.net");
+		register_stun_server("stun.us.demonware.net");
+
+		const auto lsg_server = register_server(lobby_server_name);
+		const auto auth_server = register_server(auth_server_name);
+
+		register_services(lsg_server.get(), auth_server.get(), false);
+	}
+
 	void dw::post_load()
 	{
-		message_thread_ = std::thread(server_thread);
+		static const std::string capture_path = "players2/demonware.capture";
+
+		// Runs against a separate set of servers, the live ones never see replayed traffic
+		if (utils::flags::has_flag("dwreplay") || utils::flags::has_flag("dwbenchmark"))
+		{
+			const auto lsg_server = std::make_shared<service_server>(lobby_server_name);
+			const auto auth_server = std::make_shared<service_server>(auth_server_name);
+
+			register_services(lsg_server.get(), auth_server.get(), true);
+
+			if (utils::flags::has_flag("dwreplay"))
+			{
+				replay::replay_capture(capture_path, {lsg_server, auth_server});
+			}
+
+			if (utils::flags::has_flag("dwbenchmark"))
+			{
+				replay::benchmark(lsg_server.get());
+			}
+		}
+
+		std::shared_ptr<capture> traffic_capture;
+		if (utils::flags::has_flag("dwcapture"))
+		{
+			traffic_capture = std::make_shared<capture>(capture_path);
+			if (!traffic_capture->is_open()) traffic_capture = {};
+		}
+
+		{
+			std::shared_lock _(routing_mutex_);
+
+			for (auto& server : servers_)
+			{
+				if (traffic_capture) server.second->set_capture(traffic_capture);
+				server.second->start();
+			}
+		}
+
+		command::add("dwStats", []()
+		{
+			print_metrics();
+		});
 
 		io::register_hook("send", io::send);
 		io::register_hook("recv", io::recv);
@@ -1,5 +1,7 @@
 #pragma once
 #include <loader/module_loader.hpp>
+#include <utils/concurrency.hpp>
+#include <utils/cryptography.hpp>
 
 #include "game/demonware/stun_server.hpp"
 #include "game/demonware/service_server.hpp"
@@ -20,7 +22,7 @@ namespace demonware
 		template <typename... Args>
 		static std::shared_ptr<service_server> register_server(Args ... args)
 		{
-			std::lock_guard _(server_mutex_);
+			std::unique_lock _(routing_mutex_);
 			auto server = std::make_shared<service_server>(args...);
 			servers_[server->get_address()] = server;
 			return server;
@@ -28,9 +30,10 @@ namespace demonware
 
 		static std::shared_ptr<stun_server> register_stun_server(const std::string& name)
 		{
-			std::lock_guard _(server_mutex_);
+			std::unique_lock _(routing_mutex_);
 			auto server = std::make_shared<stun_server>(name);
 			stun_servers_[server->get_address()] = server;
+			stun_addresses_.add(server->get_address());
 			return server;
 		}
 
@@ -51,23 +54,46 @@ namespace demonware
 		static void unlink_socket(SOCKET sock);
 
 		static void set_key(bool encrypt, uint8_t* key);
-		static uint8_t* get_key(bool encrypt);
+		static std::string get_key(bool encrypt);
+
+		static std::shared_ptr<const utils::cryptography::des3::context> get_cipher(bool encrypt);
+
+		static void print_metrics();
+		static std::string get_iv(uint32_t seed);
 
 	private:
-		static bool terminate_;
-		static std::thread message_thread_;
-		static std::recursive_mutex server_mutex_;
+		static std::shared_mutex routing_mutex_;
+		static std::shared_mutex datagram_mutex_;
+		static std::shared_mutex blocking_mutex_;
+
+		static std::condition_variable_any datagram_condition_;
 
 		static uint8_t encryption_key_[24];
 		static uint8_t decryption_key_[24];
 
-		static std::map<SOCKET, bool> blocking_sockets_;
-		static std::map<SOCKET, std::shared_ptr<service_server>> socket_links_;
-		static std::map<unsigned long, std::shared_ptr<service_server>> servers_;
-		static std::map<unsigned long, std::shared_ptr<stun_server>> stun_servers_;
-		static std::map<SOCKET, std::queue<std::pair<std::string, std::string>>> datagram_packets_;
+		static std::mutex cipher_mutex_;
+		static std::shared_ptr<const utils::cryptography::des3::context> encryption_cipher_;
+		static std::shared_ptr<const utils::cryptography::des3::context> decryption_cipher_;
+
+		static std::mutex iv_mutex_;
+		static std::pair<uint32_t, std::string> iv_cache_[16];
+
+		// Guarded by blocking_mutex_. Sockets are usually made non-blocking before they connect,
+		// so the filter can't skip them, but ioctlsocket and closesocket stay off routing_mutex_.
+		static std::unordered_map<SOCKET, bool> blocking_sockets_;
+
+		// Guarded by routing_mutex_, lookups only take it shared
+		static std::unordered_map<SOCKET, std::shared_ptr<service_server>> socket_links_;
+		static std::unordered_map<unsigned long, std::shared_ptr<service_server>> servers_;
+		static std::unordered_map<unsigned long, std::shared_ptr<stun_server>> stun_servers_;
+
+		// Guarded by datagram_mutex_
+		static std::unordered_map<SOCKET, std::queue<std::pair<std::string, std::string>>> datagram_packets_;
 
-		static void server_thread();
+		// Checked before any lock is taken, so game traffic on
+		// sockets DW never saw skips the tables entirely
+		static utils::concurrency::filter<4096> dw_sockets_;
+		static utils::concurrency::filter<64> stun_addresses_;
 
 		static void bd_logger_stub(int /*type*/, const char* /*channelName*/, const char*, const char* /*file*/,
 		                           const char* function, unsigned int /*line*/, const char* msg, ...);
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <shellapi.h>
 #include <csetjmp>
+#include <cassert>
 
 // min and max is required by gdi, therefore NOMINMAX won't work
 #ifdef max
@@ -40,9 +41,15 @@
 #endif
 
 #include <map>
+#include <list>
+#include <set>
 #include <atomic>
+#include <array>
+#include <bit>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
 #include <queue>
 #include <regex>
 #include <chrono>
@@ -2,6 +2,8 @@
 #include "memory.hpp"
 #include "compression.hpp"
 
+#include <zdict.h>
+
 namespace utils::compression
 {
 	std::string zlib::compress(const std::string& data)
@@ -85,4 +87,88 @@ namespace utils::compression
 
 		return std::string(buffer, size);
 	}
+
+	zstd::dictionary::dictionary(const std::string& data, const int level)
+	{
+		this->compression_dictionary_ = ZSTD_createCDict(data.data(), data.size(), level);
+		this->decompression_dictionary_ = ZSTD_createDDict(data.data(), data.size());
+		this->id_ = ZSTD_getDictID_fromDict(data.data(), data.size());
+	}
+
+	zstd::dictionary::~dictionary()
+	{
+		ZSTD_freeCDict(this->compression_dictionary_);
+		ZSTD_freeDDict(this->decompression_dictionary_);
+	}
+
+	bool zstd::dictionary::is_valid() const
+	{
+		return this->compression_dictionary_ && this->decompression_dictionary_;
+	}
+
+	uint32_t zstd::dictionary::get_id() const
+	{
+		return this->id_;
+	}
+
+	std::string zstd::compress(const std::string_view data, const int level, const dictionary* dict)
+	{
+		static thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(
+			ZSTD_createCCtx(), ZSTD_freeCCtx);
+
+		std::string buffer;
+		buffer.resize(ZSTD_compressBound(data.size()));
+
+		const auto size = dict && dict->is_valid()
+			                  ? ZSTD_compress_usingCDict(context.get(), buffer.data(), buffer.size(), data.data(),
+			                                             data.size(), dict->compression_dictionary_)
+			                  : ZSTD_compressCCtx(context.get(), buffer.data(), buffer.size(), data.data(),
+			                                      data.size(), level);
+
+		if (ZSTD_isError(size)) return {};
+
+		buffer.resize(size);
+		return buffer;
+	}
+
+	bool zstd::decompress(const std::string_view data, const size_t size, std::string* output,
+	                      const dictionary* dict)
+	{
+		static thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context(
+			ZSTD_createDCtx(), ZSTD_freeDCtx);
+
+		output->resize(size);
+
+		const auto result = dict && dict->is_valid()
+			                    ? ZSTD_decompress_usingDDict(context.get(), output->data(), output->size(),
+			                                                 data.data(), data.size(),
+			                                                 dict->decompression_dictionary_)
+			                    : ZSTD_decompressDCtx(context.get(), output->data(), output->size(), data.data(),
+			                                          data.size());
+
+		return !ZSTD_isError(result) && result == size;
+	}
+
+	std::string zstd::train_dictionary(const std::vector<std::string>& samples, const size_t capacity)
+	{
+		std::string buffer;
+		std::vector<size_t> sizes;
+		sizes.reserve(samples.size());
+
+		for (const auto& sample : samples)
+		{
+			buffer.append(sample);
+			sizes.push_back(sample.size());
+		}
+
+		std::string dict;
+		dict.resize(capacity);
+
+		const auto size = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(), sizes.data(),
+		                                        static_cast<unsigned>(sizes.size()));
+		if (ZDICT_isError(size)) return {};
+
+		dict.resize(size);
+		return dict;
+	}
 }
@@ -14,7 +14,35 @@ namespace utils::compression
 	class zstd final
 	{
 	public:
+		// Digested once, can be shared by any number of threads
+		class dictionary final
+		{
+		public:
+			dictionary(const std::string& data, int level);
+			~dictionary();
+
+			dictionary(dictionary&&) = delete;
+			dictionary(const dictionary&) = delete;
+			dictionary& operator=(const dictionary&) = delete;
+
+			bool is_valid() const;
+			uint32_t get_id() const;
+
+		private:
+			friend zstd;
+
+			ZSTD_CDict* compression_dictionary_ = nullptr;
+			ZSTD_DDict* decompression_dictionary_ = nullptr;
+			uint32_t id_ = 0;
+		};
+
 		static std::string compress(const std::string& data);
 		static std::string decompress(const std::string& data);
+
+		// Reuse per-thread contexts, the dictionary is optional
+		static std::string compress(std::string_view data, int level, const dictionary* dict);
+		static bool decompress(std::string_view data, size_t size, std::string* output, const dictionary* dict);
+
+		static std::string train_dictionary(const std::vector<std::string>& samples, size_t capacity);
 	};
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mutex>
+#include <atomic>
 
 namespace utils::concurrency
 {
@@ -43,4 +44,45 @@ namespace utils::concurrency
 		mutable MutexType mutex_{};
 		T object_{};
 	};
+
+	// Lock-free membership hint over integer keys.
+	// A key that was never added is always reported as absent,
+	// colliding keys may be reported as present.
+	template <size_t Size>
+	class filter
+	{
+		static_assert((Size & (Size - 1)) == 0, "Filter size must be a power of two");
+
+	public:
+		void add(const uint64_t key)
+		{
+			slots_[index(key)].fetch_add(1, std::memory_order_release);
+		}
+
+		void remove(const uint64_t key)
+		{
+			slots_[index(key)].fetch_sub(1, std::memory_order_release);
+		}
+
+		bool may_contain(const uint64_t key) const
+		{
+			return slots_[index(key)].load(std::memory_order_acquire) != 0;
+		}
+
+		void clear()
+		{
+			for (auto& slot : slots_)
+			{
+				slot.store(0, std::memory_order_release);
+			}
+		}
+
+	private:
+		std::atomic<uint32_t> slots_[Size]{};
+
+		static size_t index(const uint64_t key)
+		{
+			return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & (Size - 1);
+		}
+	};
 }
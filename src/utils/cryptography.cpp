@@ -165,60 +165,85 @@ namespace utils::cryptography
 
 	void rsa::initialize()
 	{
-		static auto initialized = false;
-		if (initialized) return;
-		initialized = true;
-
-		ltc_mp = ltm_desc;
-		register_hash(&sha1_desc);
-		register_prng(&yarrow_desc);
+		// Contexts may be created from several threads at once
+		static std::once_flag initialized;
+		std::call_once(initialized, []
+		{
+			ltc_mp = ltm_desc;
+			register_hash(&sha1_desc);
+			register_prng(&yarrow_desc);
+		});
 	}
 
-	std::string des3::encrypt(const std::string& data, const std::string& iv, const std::string& key)
+	des3::context::context(const std::string& key)
 	{
 		initialize();
 
-		std::string enc_data;
-		enc_data.resize(data.size());
+		const uint8_t iv[8]{};
+		this->valid_ = cbc_start(find_cipher("3des"), iv, reinterpret_cast<const uint8_t*>(key.data()),
+		                         key.size(), 0, &this->cbc_) == CRYPT_OK;
+	}
 
-		symmetric_CBC cbc;
-		const auto des3 = find_cipher("3des");
+	bool des3::context::is_valid() const
+	{
+		return this->valid_;
+	}
 
-		cbc_start(des3, reinterpret_cast<const uint8_t*>(iv.data()), reinterpret_cast<const uint8_t*>(key.data()),
-		          key.size(), 0, &cbc);
-		cbc_encrypt(reinterpret_cast<const uint8_t*>(data.data()),
-		            reinterpret_cast<uint8_t*>(const_cast<char*>(enc_data.data())), data.size(), &cbc);
-		cbc_done(&cbc);
+	bool des3::context::start(const std::string_view iv, symmetric_CBC* cbc) const
+	{
+		if (!this->valid_ || iv.size() < 8) return false;
 
-		return enc_data;
+		*cbc = this->cbc_;
+		return cbc_setiv(reinterpret_cast<const uint8_t*>(iv.data()), 8, cbc) == CRYPT_OK;
 	}
 
-	std::string des3::decrypt(const std::string& data, const std::string& iv, const std::string& key)
+	void des3::context::encrypt(char* data, const size_t length, const std::string_view iv) const
 	{
-		initialize();
+		symmetric_CBC cbc;
+		if (!this->start(iv, &cbc)) return;
 
-		std::string dec_data;
-		dec_data.resize(data.size());
+		cbc_encrypt(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<uint8_t*>(data), length, &cbc);
+	}
 
+	void des3::context::decrypt(char* data, const size_t length, const std::string_view iv) const
+	{
 		symmetric_CBC cbc;
-		const auto des3 = find_cipher("3des");
+		if (!this->start(iv, &cbc)) return;
 
-		cbc_start(des3, reinterpret_cast<const uint8_t*>(iv.data()), reinterpret_cast<const uint8_t*>(key.data()),
-		          key.size(), 0, &cbc);
-		cbc_decrypt(reinterpret_cast<const uint8_t*>(data.data()),
-		            reinterpret_cast<uint8_t*>(const_cast<char*>(dec_data.data())), data.size(), &cbc);
-		cbc_done(&cbc);
+		cbc_decrypt(reinterpret_cast<const uint8_t*>(data), reinterpret_cast<uint8_t*>(data), length, &cbc);
+	}
 
+	std::string des3::context::encrypt(const std::string_view data, const std::string_view iv) const
+	{
+		std::string enc_data(data);
+		this->encrypt(enc_data.data(), enc_data.size(), iv);
+		return enc_data;
+	}
+
+	std::string des3::context::decrypt(const std::string_view data, const std::string_view iv) const
+	{
+		std::string dec_data(data);
+		this->decrypt(dec_data.data(), dec_data.size(), iv);
 		return dec_data;
 	}
 
-	void des3::initialize()
+	std::string des3::encrypt(const std::string& data, const std::string& iv, const std::string& key)
 	{
-		static auto initialized = false;
-		if (initialized) return;
-		initialized = true;
+		return context(key).encrypt(data, iv);
+	}
 
-		register_cipher(&des3_desc);
+	std::string des3::decrypt(const std::string& data, const std::string& iv, const std::string& key)
+	{
+		return context(key).decrypt(data, iv);
+	}
+
+	void des3::initialize()
+	{
+		static std::once_flag initialized;
+		std::call_once(initialized, []
+		{
+			register_cipher(&des3_desc);
+		});
 	}
 
 	std::string tiger::compute(const std::string& data, const bool hex)
@@ -48,6 +48,28 @@ namespace utils::cryptography
 	class des3 final
 	{
 	public:
+		// Runs the key schedule once, operations only reset the IV
+		class context final
+		{
+		public:
+			context() = default;
+			explicit context(const std::string& key);
+
+			bool is_valid() const;
+
+			std::string encrypt(std::string_view data, std::string_view iv) const;
+			std::string decrypt(std::string_view data, std::string_view iv) const;
+
+			void encrypt(char* data, size_t length, std::string_view iv) const;
+			void decrypt(char* data, size_t length, std::string_view iv) const;
+
+		private:
+			symmetric_CBC cbc_{};
+			bool valid_ = false;
+
+			bool start(std::string_view iv, symmetric_CBC* cbc) const;
+		};
+
 		static std::string encrypt(const std::string& data, const std::string& iv, const std::string& key);
 		static std::string decrypt(const std::string& data, const std::string& iv, const std::string& key);
 
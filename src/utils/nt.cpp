@@ -216,6 +216,11 @@ namespace utils::nt
 	}
 
 	std::string load_resource(const int id)
+	{
+		return std::string(get_resource(id));
+	}
+
+	std::string_view get_resource(const int id)
 	{
 		auto* const res = FindResource(library(), MAKEINTRESOURCE(id), RT_RCDATA);
 		if (!res) return {};
@@ -223,7 +228,88 @@ namespace utils::nt
 		auto* const handle = LoadResource(nullptr, res);
 		if (!handle) return {};
 
-		return std::string(LPSTR(LockResource(handle)), SizeofResource(nullptr, res));
+		return std::string_view(LPSTR(LockResource(handle)), SizeofResource(nullptr, res));
+	}
+
+	mapped_file::mapped_file(const std::string& path)
+	{
+		this->file_ = CreateFileA(path.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                          FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (this->file_ == INVALID_HANDLE_VALUE) return;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(this->file_, &size) || !size.QuadPart || size.QuadPart > SIZE_MAX)
+		{
+			// Empty files can't be mapped
+			this->close();
+			return;
+		}
+
+		this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (this->mapping_)
+		{
+			this->view_ = static_cast<const char*>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+		}
+
+		if (!this->view_)
+		{
+			this->close();
+			return;
+		}
+
+		this->size_ = size_t(size.QuadPart);
+	}
+
+	mapped_file::~mapped_file()
+	{
+		this->close();
+	}
+
+	mapped_file::mapped_file(mapped_file&& obj) noexcept
+	{
+		this->operator=(std::move(obj));
+	}
+
+	mapped_file& mapped_file::operator=(mapped_file&& obj) noexcept
+	{
+		if (this != &obj)
+		{
+			this->close();
+
+			this->file_ = obj.file_;
+			this->mapping_ = obj.mapping_;
+			this->view_ = obj.view_;
+			this->size_ = obj.size_;
+
+			obj.file_ = INVALID_HANDLE_VALUE;
+			obj.mapping_ = nullptr;
+			obj.view_ = nullptr;
+			obj.size_ = 0;
+		}
+
+		return *this;
+	}
+
+	bool mapped_file::is_valid() const
+	{
+		return this->view_ != nullptr;
+	}
+
+	std::string_view mapped_file::get_data() const
+	{
+		return std::string_view(this->view_, this->size_);
+	}
+
+	void mapped_file::close()
+	{
+		if (this->view_) UnmapViewOfFile(this->view_);
+		if (this->mapping_) CloseHandle(this->mapping_);
+		if (this->file_ != INVALID_HANDLE_VALUE) CloseHandle(this->file_);
+
+		this->file_ = INVALID_HANDLE_VALUE;
+		this->mapping_ = nullptr;
+		this->view_ = nullptr;
+		this->size_ = 0;
 	}
 
 	void relaunch_self()
@@ -86,9 +86,38 @@ namespace utils::nt
 		HMODULE module_;
 	};
 
+	// Read-only view of a file, backed by the page cache instead of heap memory
+	class mapped_file final
+	{
+	public:
+		mapped_file() = default;
+		explicit mapped_file(const std::string& path);
+		~mapped_file();
+
+		mapped_file(mapped_file&& obj) noexcept;
+		mapped_file& operator=(mapped_file&& obj) noexcept;
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		bool is_valid() const;
+		std::string_view get_data() const;
+
+	private:
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+		const char* view_ = nullptr;
+		size_t size_ = 0;
+
+		void close();
+	};
+
 	__declspec(noreturn) void raise_hard_exception();
 	std::string load_resource(int id);
 
+	// Resources stay mapped as long as the module is loaded
+	std::string_view get_resource(int id);
+
 	void relaunch_self();
 	__declspec(noreturn) void terminate(uint32_t code = 0);
 }